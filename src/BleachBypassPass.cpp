@@ -61,28 +61,30 @@ namespace itg
                                              mixRGB += ( ( 1.0 - A2 ) * base.rgb );
                                              
                                              gl_FragColor = vec4( mixRGB, base.a );
+                                             gl_FragColor = applyLumaToAlpha(gl_FragColor);
                                              
                                          }
         );
         
-        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
+        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, getLumaToAlphaSrc() + fragShaderSrc);
         shader.linkProgram();
         
     }
     
     void BleachBypassPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         
         shader.begin();
         
         shader.setUniformTexture("tDiffuse", readFbo.getTexture(), 0);
         shader.setUniform1f("opacity", opacity);
+        shader.setUniform1i("lumaToAlpha", writeLumaToAlpha ? 1 : 0);
         
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
\ No newline at end of file
@@ -48,6 +48,12 @@ namespace itg
         
         void setOpacity(float v){ opacity = v; }
         float getOpacity() { return opacity; }
+
+        bool canWriteLumaToAlpha() const { return true; }
+        
+        bool isColorMapping() const { return true; }
+        bool isIdentity() const { return opacity == 0.f; }
+        void getParameters(vector<float>& parameters) const { parameters.push_back(opacity); }
     private:
         
         ofShader shader;
@@ -34,8 +34,14 @@
 
 namespace itg
 {
-    BloomPass::BloomPass(const ofVec2f& aspect, bool arb, const ofVec2f& xBlur, const ofVec2f& yBlur, unsigned resolution, bool aspectCorrect) : RenderPass(aspect, arb, "bloom")
+    BloomPass::BloomPass(const ofVec2f& aspect, bool arb, const ofVec2f& xBlur, const ofVec2f& yBlur, unsigned resolution, bool aspectCorrect) :
+        levelsWidth(0), levelsHeight(0), mode(MODE_GAUSSIAN), numLevels(5), RenderPass(aspect, arb, "bloom")
     {
+        Parameters p = { 0.f, 0.1f, 1.f };
+        parameters.write(p);
+        parameters.latch();
+        guiParameters = latchedGuiParameters = p;
+        
         currentReadFbo = 0;
         if (resolution != ofNextPow2(resolution)) ofLogWarning() << "Resolution " << resolution << " is not a power of two, using " << ofNextPow2(resolution);
         
@@ -59,6 +65,8 @@ namespace itg
         s.useDepth = true;
         
         for (int i = 0; i < 2; ++i) fbos[i].allocate(s);
+        
+        setupComposite();
     }
     
     void BloomPass::allocateSelectiveGlow(unsigned w, unsigned h)
@@ -100,21 +108,254 @@ namespace itg
         glPopMatrix();
     }
     
+    void BloomPass::latchParameters()
+    {
+        // only the fields the gui changed are published so sets from other threads aren't undone
+        const Parameters edited = guiParameters;
+        const Parameters& latched = latchedGuiParameters;
+        if (edited.threshold != latched.threshold) setThreshold(edited.threshold);
+        if (edited.knee != latched.knee) setKnee(edited.knee);
+        if (edited.intensity != latched.intensity) setIntensity(edited.intensity);
+        
+        parameters.latch();
+        guiParameters = latchedGuiParameters = parameters.getReadRef();
+    }
+    
     void BloomPass::render(ofFbo& readFbo, ofFbo& writeFbo)
     {
-        if (selectiveGlow.isAllocated()) xConv->render(selectiveGlow, fbos[0]);
-        else xConv->render(readFbo, fbos[0]);
+        const Parameters& p = parameters.getReadRef();
+        ofFbo& source = selectiveGlow.isAllocated() ? selectiveGlow : readFbo;
+        if (mode == MODE_DUAL_FILTER) renderDualFilter(source);
+        else renderGaussian(source);
+        
+        ofFbo& bloom = mode == MODE_DUAL_FILTER ? levels[0] : fbos[1];
+        // every level has been added into the first one so average them
+        float scale = mode == MODE_DUAL_FILTER ? p.intensity / levels.size() : p.intensity;
+        
+        beginTarget(writeFbo);
+        compositeShader.begin();
+        compositeShader.setUniformTexture("scene", readFbo.getTexture(), 0);
+        compositeShader.setUniformTexture("bloom", bloom.getTexture(), 1);
+        compositeShader.setUniform1f("intensity", scale);
+        if (arb) compositeShader.setUniform2f("bloomScale", bloom.getWidth() / readFbo.getWidth(), bloom.getHeight() / readFbo.getHeight());
+        else compositeShader.setUniform2f("bloomScale", 1.f, 1.f);
+        
+        if (arb) texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight(), readFbo.getWidth(), readFbo.getHeight());
+        else texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+        
+        compositeShader.end();
+        endTarget(writeFbo);
+    }
+    
+    void BloomPass::renderGaussian(ofFbo& source)
+    {
+        // bright pass is done on the taps of the first blur as it downsamples
+        const Parameters& p = parameters.getReadRef();
+        xConv->setThreshold(p.threshold, p.knee);
+        xConv->render(source, fbos[0]);
         yConv->render(fbos[0], fbos[1]);
+    }
+    
+    void BloomPass::renderDualFilter(ofFbo& source)
+    {
+        if (!downsampleShader.isLoaded()) setupDualFilter();
+        allocateLevels(source.getWidth(), source.getHeight());
         
-        writeFbo.begin();
-        ofClear(0, 0, 0, 255);
-        ofSetColor(255, 255, 255);
-        readFbo.draw(0, 0);
+        // downsample, thresholding while reading the source
+        const Parameters& p = parameters.getReadRef();
+        ofFbo* src = &source;
+        for (unsigned i = 0; i < levels.size(); ++i)
+        {
+            ofShader& shader = i == 0 ? prefilterShader : downsampleShader;
+            
+            levels[i].begin();
+            shader.begin();
+            shader.setUniformTexture("tex", src->getTexture(), 0);
+            if (arb) shader.setUniform2f("texel", 1.f, 1.f);
+            else shader.setUniform2f("texel", 1.f / src->getWidth(), 1.f / src->getHeight());
+            if (i == 0)
+            {
+                float k = max(p.knee, 1e-5f);
+                shader.setUniform4f("curve", p.threshold, p.threshold - k, 2.f * k, 0.25f / k);
+            }
+            
+            if (arb) texturedQuad(0, 0, levels[i].getWidth(), levels[i].getHeight(), src->getWidth(), src->getHeight());
+            else texturedQuad(0, 0, levels[i].getWidth(), levels[i].getHeight());
+            
+            shader.end();
+            levels[i].end();
+            
+            src = &levels[i];
+        }
+        
+        // upsample, adding each level onto the next biggest one
         ofEnableAlphaBlending();
         glBlendFunc(GL_ONE, GL_ONE);
-        fbos[1].draw(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+        for (int i = levels.size() - 1; i > 0; --i)
+        {
+            levels[i - 1].begin();
+            upsampleShader.begin();
+            upsampleShader.setUniformTexture("tex", levels[i].getTexture(), 0);
+            if (arb) upsampleShader.setUniform2f("texel", 1.f, 1.f);
+            else upsampleShader.setUniform2f("texel", 1.f / levels[i].getWidth(), 1.f / levels[i].getHeight());
+            
+            if (arb) texturedQuad(0, 0, levels[i - 1].getWidth(), levels[i - 1].getHeight(), levels[i].getWidth(), levels[i].getHeight());
+            else texturedQuad(0, 0, levels[i - 1].getWidth(), levels[i - 1].getHeight());
+            
+            upsampleShader.end();
+            levels[i - 1].end();
+        }
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         ofDisableAlphaBlending();
-        writeFbo.end();
+    }
+    
+    void BloomPass::allocateLevels(unsigned width, unsigned height)
+    {
+        unsigned count = 0;
+        while (count < numLevels && (width >> (count + 1)) > 1 && (height >> (count + 1)) > 1) ++count;
+        count = max(count, 1u);
+        
+        if (levels.size() == count && levelsWidth == width && levelsHeight == height) return;
+        
+        levels.clear();
+        levels.resize(count);
+        levelsWidth = width;
+        levelsHeight = height;
+        
+        ofFbo::Settings s;
+        s.textureTarget = arb ? GL_TEXTURE_RECTANGLE_ARB : GL_TEXTURE_2D;
+        // levels are summed on the way back up so need more range than 8 bits
+        s.internalformat = GL_RGBA16F;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            s.width = max(width >> (i + 1), 1u);
+            s.height = max(height >> (i + 1), 1u);
+            levels[i].allocate(s);
+        }
+    }
+    
+    void BloomPass::setupComposite()
+    {
+        string fragShaderSrc = STRINGIFY(
+            uniform SAMPLER_TYPE scene;
+            uniform SAMPLER_TYPE bloom;
+            uniform vec2 bloomScale;
+            uniform float intensity;
+            
+            void main()
+            {
+                vec2 uv = gl_TexCoord[0].st;
+                vec3 color = TEXTURE_FN(scene, uv).rgb + TEXTURE_FN(bloom, uv * bloomScale).rgb * intensity;
+                gl_FragColor = vec4(color, 1.0);
+            }
+        );
+        
+        ostringstream oss;
+        oss << "#version 120" << endl;
+        if (arb)
+        {
+            oss << "#define SAMPLER_TYPE sampler2DRect" << endl;
+            oss << "#define TEXTURE_FN texture2DRect" << endl;
+        }
+        else
+        {
+            oss << "#define SAMPLER_TYPE sampler2D" << endl;
+            oss << "#define TEXTURE_FN texture2D" << endl;
+        }
+        oss << fragShaderSrc;
+        compositeShader.setupShaderFromSource(GL_FRAGMENT_SHADER, oss.str());
+        compositeShader.linkProgram();
+    }
+    
+    void BloomPass::setupDualFilter()
+    {
+        // 13 taps, five overlapping 4x4 box filters weighted to reduce flickering
+        string downsampleSrc = STRINGIFY(
+            uniform SAMPLER_TYPE tex;
+            uniform vec2 texel;
+            // threshold, threshold - knee, 2 * knee, 0.25 / knee
+            uniform vec4 curve;
+            
+            vec3 prefilter(vec3 c)
+            {
+                float br = max(c.r, max(c.g, c.b));
+                float rq = clamp(br - curve.y, 0.0, curve.z);
+                rq = curve.w * rq * rq;
+                return c * max(rq, br - curve.x) / max(br, 1.0e-4);
+            }
+            
+            void main()
+            {
+                vec2 uv = gl_TexCoord[0].st;
+                
+                vec3 a = TEXTURE_FN(tex, uv + texel * vec2(-2.0, -2.0)).rgb;
+                vec3 b = TEXTURE_FN(tex, uv + texel * vec2( 0.0, -2.0)).rgb;
+                vec3 c = TEXTURE_FN(tex, uv + texel * vec2( 2.0, -2.0)).rgb;
+                vec3 d = TEXTURE_FN(tex, uv + texel * vec2(-2.0,  0.0)).rgb;
+                vec3 e = TEXTURE_FN(tex, uv).rgb;
+                vec3 f = TEXTURE_FN(tex, uv + texel * vec2( 2.0,  0.0)).rgb;
+                vec3 g = TEXTURE_FN(tex, uv + texel * vec2(-2.0,  2.0)).rgb;
+                vec3 h = TEXTURE_FN(tex, uv + texel * vec2( 0.0,  2.0)).rgb;
+                vec3 i = TEXTURE_FN(tex, uv + texel * vec2( 2.0,  2.0)).rgb;
+                vec3 j = TEXTURE_FN(tex, uv + texel * vec2(-1.0, -1.0)).rgb;
+                vec3 k = TEXTURE_FN(tex, uv + texel * vec2( 1.0, -1.0)).rgb;
+                vec3 l = TEXTURE_FN(tex, uv + texel * vec2(-1.0,  1.0)).rgb;
+                vec3 m = TEXTURE_FN(tex, uv + texel * vec2( 1.0,  1.0)).rgb;
+                
+                vec3 result = e * 0.125;
+                result += (a + c + g + i) * 0.03125;
+                result += (b + d + f + h) * 0.0625;
+                result += (j + k + l + m) * 0.125;
+                
+                if (PREFILTER) result = prefilter(result);
+                
+                gl_FragColor = vec4(result, 1.0);
+            }
+        );
+        
+        // 3x3 tent filter
+        string upsampleSrc = STRINGIFY(
+            uniform SAMPLER_TYPE tex;
+            uniform vec2 texel;
+            
+            void main()
+            {
+                vec2 uv = gl_TexCoord[0].st;
+                
+                vec3 result = TEXTURE_FN(tex, uv).rgb * 4.0;
+                result += TEXTURE_FN(tex, uv + texel * vec2( 0.0, -1.0)).rgb * 2.0;
+                result += TEXTURE_FN(tex, uv + texel * vec2(-1.0,  0.0)).rgb * 2.0;
+                result += TEXTURE_FN(tex, uv + texel * vec2( 1.0,  0.0)).rgb * 2.0;
+                result += TEXTURE_FN(tex, uv + texel * vec2( 0.0,  1.0)).rgb * 2.0;
+                result += TEXTURE_FN(tex, uv + texel * vec2(-1.0, -1.0)).rgb;
+                result += TEXTURE_FN(tex, uv + texel * vec2( 1.0, -1.0)).rgb;
+                result += TEXTURE_FN(tex, uv + texel * vec2(-1.0,  1.0)).rgb;
+                result += TEXTURE_FN(tex, uv + texel * vec2( 1.0,  1.0)).rgb;
+                
+                gl_FragColor = vec4(result / 16.0, 1.0);
+            }
+        );
+        
+        ostringstream header;
+        header << "#version 120" << endl;
+        if (arb)
+        {
+            header << "#define SAMPLER_TYPE sampler2DRect" << endl;
+            header << "#define TEXTURE_FN texture2DRect" << endl;
+        }
+        else
+        {
+            header << "#define SAMPLER_TYPE sampler2D" << endl;
+            header << "#define TEXTURE_FN texture2D" << endl;
+        }
+        
+        downsampleShader.setupShaderFromSource(GL_FRAGMENT_SHADER, header.str() + "#define PREFILTER false\n" + downsampleSrc);
+        downsampleShader.linkProgram();
+        
+        prefilterShader.setupShaderFromSource(GL_FRAGMENT_SHADER, header.str() + "#define PREFILTER true\n" + downsampleSrc);
+        prefilterShader.linkProgram();
+        
+        upsampleShader.setupShaderFromSource(GL_FRAGMENT_SHADER, header.str() + upsampleSrc);
+        upsampleShader.linkProgram();
     }
 }
\ No newline at end of file
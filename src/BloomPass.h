@@ -33,14 +33,34 @@
 
 #include "RenderPass.h"
 #include "ConvolutionPass.h"
+#include "TripleBuffer.h"
 
 namespace itg
 {
     class BloomPass : public RenderPass
     {
     public:
+        /*
+         * MODE_GAUSSIAN blurs a fixed size buffer with two ConvolutionPasses,
+         * MODE_DUAL_FILTER progressively downsamples with a 13 tap filter then
+         * upsamples with a tent filter, adding each level on the way back up.
+         * @see http://www.iryoku.com/next-generation-post-processing-in-call-of-duty-advanced-warfare
+         */
+        enum Mode
+        {
+            MODE_GAUSSIAN,
+            MODE_DUAL_FILTER
+        };
+        
         typedef shared_ptr<BloomPass> Ptr;
         
+        struct Parameters
+        {
+            float threshold;
+            float knee;
+            float intensity;
+        };
+        
         BloomPass(const ofVec2f& aspect, bool arb, const ofVec2f& xBlur = ofVec2f(0.001953125, 0.0), const ofVec2f& yBlur = ofVec2f(0.0, 0.001953125), unsigned resolution = 256, bool aspectCorrect = true);
         
         void render(ofFbo& readFbo, ofFbo& writeFbo);
@@ -53,7 +73,48 @@ namespace itg
         
         bool hasArbShader() { return true; }
         
+        Mode getMode() const { return mode; }
+        void setMode(Mode mode) { this->mode = mode; }
+        
+        // number of mip levels used in MODE_DUAL_FILTER, each level is half the size of the previous
+        unsigned getNumLevels() const { return numLevels; }
+        void setNumLevels(unsigned numLevels) { this->numLevels = max(numLevels, 1u); }
+        
+        // getters and setters can be called from any thread, set values are
+        // used from the next PostProcessing::begin(). The Ref getters edit a
+        // render thread copy for a gui, see DofAltPass.
+        
+        // brightness above which pixels start to glow, applied while reading the source in both modes
+        float getThreshold() const { return parameters.getLatest().threshold; }
+        void setThreshold(float threshold) { parameters.modify([threshold](Parameters& p) { p.threshold = threshold; }); }
+        
+        // width of the soft transition around the threshold
+        float getKnee() const { return parameters.getLatest().knee; }
+        void setKnee(float knee) { parameters.modify([knee](Parameters& p) { p.knee = knee; }); }
+        
+        float& getThresholdRef() { return guiParameters.threshold; }
+        float& getKneeRef() { return guiParameters.knee; }
+        
+        float getIntensity() const { return parameters.getLatest().intensity; }
+        void setIntensity(float intensity) { parameters.modify([intensity](Parameters& p) { p.intensity = intensity; }); }
+        float& getIntensityRef() { return guiParameters.intensity; }
+        
+        void setParameters(const Parameters& parameters) { this->parameters.write(parameters); }
+        Parameters getLatestParameters() const { return parameters.getLatest(); }
+        void latchParameters();
+        
+        bool isIdentity() const { return parameters.getReadRef().intensity == 0.f; }
+        
+        ConvolutionPass::Ptr getXConvolution() const { return xConv; }
+        ConvolutionPass::Ptr getYConvolution() const { return yConv; }
+        
     private:
+        void renderGaussian(ofFbo& source);
+        void renderDualFilter(ofFbo& source);
+        void setupDualFilter();
+        void setupComposite();
+        void allocateLevels(unsigned width, unsigned height);
+        
         ConvolutionPass::Ptr xConv;
         ConvolutionPass::Ptr yConv;
         
@@ -61,6 +122,24 @@ namespace itg
         // small fbos for rendering stuff to glow
         ofFbo fbos[2];
         
+        // mip chain for dual filter mode, levels[0] is half the size of the source
+        vector<ofFbo> levels;
+        unsigned levelsWidth, levelsHeight;
+        ofShader downsampleShader;
+        ofShader prefilterShader;
+        ofShader upsampleShader;
+        
+        // adds the bloom onto the scene in one draw
+        ofShader compositeShader;
+        
+        Mode mode;
+        unsigned numLevels;
+        
+        TripleBuffer<Parameters> parameters;
+        // render thread only, what the Ref getters edit and what they held after the last latch
+        Parameters guiParameters;
+        Parameters latchedGuiParameters;
+        
         unsigned currentReadFbo;
         unsigned w, h;
     };
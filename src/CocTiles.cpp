@@ -0,0 +1,110 @@
+/*
+ *  CocTiles.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "CocTiles.h"
+
+namespace itg
+{
+    CocTiles::CocTiles() : width(0), height(0)
+    {
+    }
+    
+    string CocTiles::getReductionSrc(unsigned halo)
+    {
+        string src = STRINGIFY(
+            uniform vec2 cocTilesTexel;
+                               
+            void main()
+            {
+                vec2 origin = floor(gl_FragCoord.xy) * float(COC_TILE_SIZE);
+                float maxCoc = 0.0;
+                float minCoc = 1.0e10;
+                for (int y = -COC_TILE_HALO; y < COC_TILE_SIZE + COC_TILE_HALO; y++)
+                {
+                    for (int x = -COC_TILE_HALO; x < COC_TILE_SIZE + COC_TILE_HALO; x++)
+                    {
+                        float coc = tileCoc((origin + vec2(float(x), float(y)) + 0.5) * cocTilesTexel);
+                        maxCoc = max(maxCoc, coc);
+                        minCoc = min(minCoc, coc);
+                    }
+                }
+                gl_FragColor = vec4(maxCoc, minCoc, 0.0, 1.0);
+            }
+        );
+        
+        ostringstream oss;
+        oss << "#define COC_TILE_SIZE " << TILE_SIZE << endl;
+        oss << "#define COC_TILE_HALO " << halo << endl;
+        oss << src;
+        return oss.str();
+    }
+    
+    void CocTiles::begin(ofShader& shader, unsigned width, unsigned height)
+    {
+        if (this->width != width || this->height != height || !fbo.isAllocated())
+        {
+            this->width = width;
+            this->height = height;
+            
+            ofFbo::Settings s;
+            s.width = (width + TILE_SIZE - 1) / TILE_SIZE;
+            s.height = (height + TILE_SIZE - 1) / TILE_SIZE;
+            s.textureTarget = GL_TEXTURE_2D;
+            s.internalformat = GL_RGBA16F;
+            s.minFilter = GL_NEAREST;
+            s.maxFilter = GL_NEAREST;
+            fbo.allocate(s);
+        }
+        
+        fbo.begin();
+        shader.begin();
+        shader.setUniform2f("cocTilesTexel", 1.f / width, 1.f / height);
+    }
+    
+    void CocTiles::end(ofShader& shader)
+    {
+        glBegin(GL_QUADS);
+        glVertex2f(0, 0);
+        glVertex2f(fbo.getWidth(), 0);
+        glVertex2f(fbo.getWidth(), fbo.getHeight());
+        glVertex2f(0, fbo.getHeight());
+        glEnd();
+        
+        shader.end();
+        fbo.end();
+    }
+    
+    ofVec2f CocTiles::getScale() const
+    {
+        if (!width || !height) return ofVec2f(1.f, 1.f);
+        return ofVec2f(width / (float)(fbo.getWidth() * TILE_SIZE), height / (float)(fbo.getHeight() * TILE_SIZE));
+    }
+}
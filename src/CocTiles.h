@@ -0,0 +1,72 @@
+/*
+ *  CocTiles.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "RenderPass.h"
+
+namespace itg
+{
+    /*
+     * Reduces the circle of confusion of a depth of field pass to its maximum
+     * and minimum over each TILE_SIZE x TILE_SIZE tile of the screen. The
+     * pass can then look up its tile and copy in focus pixels instead of
+     * running the full gather, the branch is coherent across a whole tile.
+     *
+     * The reduction program is built by the pass as its own glsl, defining
+     * float tileCoc(vec2 uv), followed by getReductionSrc().
+     */
+    class CocTiles
+    {
+    public:
+        static const unsigned TILE_SIZE = 16;
+        
+        CocTiles();
+        
+        // halo is the number of extra pixels around each tile that can affect the coc inside it
+        static string getReductionSrc(unsigned halo = 0);
+        
+        // binds the tile buffer and the reduction program, set any uniforms the
+        // program needs between begin() and end()
+        void begin(ofShader& shader, unsigned width, unsigned height);
+        void end(ofShader& shader);
+        
+        // r is the maximum coc of a tile and g the minimum
+        ofTexture& getTexture() { return fbo.getTexture(); }
+        
+        // multiply full resolution texture coordinates by this to look up a tile
+        ofVec2f getScale() const;
+        
+    private:
+        ofFbo fbo;
+        unsigned width, height;
+    };
+}
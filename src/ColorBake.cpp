@@ -0,0 +1,227 @@
+/*
+ *  ColorBake.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "ColorBake.h"
+
+namespace itg
+{
+    ColorBake::ColorBake(unsigned size) : lut(0), size(ofClamp(size, 2, MAX_SIZE)), numBakes(0)
+    {
+        // slice b of the lut is the size x size square starting at x = b * size
+        string identitySrc = STRINGIFY(
+            uniform float size;
+            
+            void main()
+            {
+                vec2 texel = floor(gl_FragCoord.xy);
+                gl_FragColor = vec4(vec3(mod(texel.x, size), texel.y, floor(texel.x / size)) / (size - 1.0), 1.0);
+            }
+        );
+        identityShader.setupShaderFromSource(GL_FRAGMENT_SHADER, identitySrc);
+        identityShader.linkProgram();
+        
+        string fragShaderSrc = STRINGIFY(
+            uniform sampler2D tex;
+            uniform sampler3D lut;
+            uniform float size;
+            
+            void main()
+            {
+                vec4 c = texture2D(tex, gl_TexCoord[0].st);
+                vec3 p = (clamp(c.rgb, 0.0, 1.0) * (size - 1.0) + 0.5) / size;
+                gl_FragColor = vec4(texture3D(lut, p).rgb, c.a);
+                gl_FragColor = applyLumaToAlpha(gl_FragColor);
+            }
+        );
+        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, RenderPass::getLumaToAlphaSrc() + fragShaderSrc);
+        shader.linkProgram();
+    }
+    
+    ColorBake::~ColorBake()
+    {
+        if (lut) glDeleteTextures(1, &lut);
+    }
+    
+    void ColorBake::setSize(unsigned size)
+    {
+        size = ofClamp(size, 2, MAX_SIZE);
+        if (size == this->size) return;
+        this->size = size;
+        // forces a bake on the next update
+        bakedPasses.clear();
+    }
+    
+    void ColorBake::update(const vector<RenderPass*>& passes)
+    {
+        vector<float> parameters;
+        for (unsigned i = 0; i < passes.size(); ++i) passes[i]->getParameters(parameters);
+        if (passes != bakedPasses || parameters != bakedParameters)
+        {
+            bake(passes);
+            bakedPasses = passes;
+            bakedParameters.swap(parameters);
+        }
+    }
+    
+    void ColorBake::bake(const vector<RenderPass*>& passes)
+    {
+        const unsigned w = size * size;
+        const unsigned h = size;
+        // bakes only run without arb so the passes sample the strip as a GL_TEXTURE_2D
+        ofFbo::Settings s;
+        s.width = w;
+        s.height = h;
+        s.internalformat = GL_RGBA32F;
+        s.textureTarget = GL_TEXTURE_2D;
+        s.minFilter = GL_NEAREST;
+        s.maxFilter = GL_NEAREST;
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            if (!strip[i].isAllocated() || strip[i].getWidth() != w || strip[i].getHeight() != h) strip[i].allocate(s);
+        }
+        
+        strip[0].begin();
+        identityShader.begin();
+        identityShader.setUniform1f("size", size);
+        ofDrawRectangle(0, 0, w, h);
+        identityShader.end();
+        strip[0].end();
+        
+        // the last pass may write luma to alpha, blending with it would change the baked colours
+        glPushAttrib(GL_COLOR_BUFFER_BIT);
+        glDisable(GL_BLEND);
+        unsigned current = 0;
+        for (unsigned i = 0; i < passes.size(); ++i)
+        {
+            passes[i]->render(strip[current], strip[1 - current], noDepth);
+            current = 1 - current;
+        }
+        glPopAttrib();
+        
+        if (!lut) glGenTextures(1, &lut);
+        glEnable(GL_TEXTURE_3D);
+        glBindTexture(GL_TEXTURE_3D, lut);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, size, size, size, 0, GL_RGB, GL_FLOAT, NULL);
+        
+        // copy each slice straight from the fbo so the bake never leaves the gpu
+        strip[current].begin();
+        for (unsigned b = 0; b < size; ++b)
+        {
+            glCopyTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, b, b * size, 0, size, size);
+        }
+        strip[current].end();
+        
+        glBindTexture(GL_TEXTURE_3D, 0);
+        glDisable(GL_TEXTURE_3D);
+        
+        ++numBakes;
+    }
+    
+    void ColorBake::render(ofFbo& readFbo, ofFbo& writeFbo, bool lumaToAlpha)
+    {
+        writeFbo.begin();
+        // see PostProcessing, alpha holds luma rather than coverage
+        glPushAttrib(GL_COLOR_BUFFER_BIT);
+        if (lumaToAlpha) glDisable(GL_BLEND);
+        
+        shader.begin();
+        
+        shader.setUniformTexture("tex", readFbo.getTexture(), 0);
+        shader.setUniformTexture("lut", GL_TEXTURE_3D, lut, 1);
+        shader.setUniform1f("size", size);
+        shader.setUniform1i("lumaToAlpha", lumaToAlpha ? 1 : 0);
+        
+        glBegin(GL_QUADS);
+        glTexCoord2f(0, 0); glVertex2f(0, 0);
+        glTexCoord2f(1, 0); glVertex2f(writeFbo.getWidth(), 0);
+        glTexCoord2f(1, 1); glVertex2f(writeFbo.getWidth(), writeFbo.getHeight());
+        glTexCoord2f(0, 1); glVertex2f(0, writeFbo.getHeight());
+        glEnd();
+        
+        shader.end();
+        
+        glPopAttrib();
+        writeFbo.end();
+    }
+    
+    void ColorBake::render(MultisampleFbo& multisampleFbo, ofFbo& writeFbo, bool lumaToAlpha)
+    {
+        if (!multisampleShader.isLoaded())
+        {
+            string fragShaderSrc = STRINGIFY(
+                uniform sampler2DMS tex;
+                uniform sampler3D lut;
+                uniform float size;
+                uniform int numSamples;
+                
+                void main()
+                {
+                    ivec2 texel = ivec2(gl_FragCoord.xy);
+                    vec4 c = vec4(0.0);
+                    for (int i = 0; i < numSamples; ++i)
+                    {
+                        vec4 s = texelFetch(tex, texel, i);
+                        vec3 p = (clamp(s.rgb, 0.0, 1.0) * (size - 1.0) + 0.5) / size;
+                        c += vec4(texture(lut, p).rgb, s.a);
+                    }
+                    gl_FragColor = c / float(numSamples);
+                    gl_FragColor = applyLumaToAlpha(gl_FragColor);
+                }
+            );
+            multisampleShader.setupShaderFromSource(GL_FRAGMENT_SHADER, "#version 150 compatibility\n" + RenderPass::getLumaToAlphaSrc() + fragShaderSrc);
+            multisampleShader.linkProgram();
+        }
+        
+        writeFbo.begin();
+        glPushAttrib(GL_COLOR_BUFFER_BIT);
+        if (lumaToAlpha) glDisable(GL_BLEND);
+        
+        multisampleShader.begin();
+        
+        multisampleShader.setUniformTexture("tex", GL_TEXTURE_2D_MULTISAMPLE, multisampleFbo.getColorTextureId(), 0);
+        multisampleShader.setUniformTexture("lut", GL_TEXTURE_3D, lut, 1);
+        multisampleShader.setUniform1f("size", size);
+        multisampleShader.setUniform1i("numSamples", multisampleFbo.getNumSamples());
+        multisampleShader.setUniform1i("lumaToAlpha", lumaToAlpha ? 1 : 0);
+        
+        ofDrawRectangle(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+        
+        multisampleShader.end();
+        
+        glPopAttrib();
+        writeFbo.end();
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ *  ColorBake.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "RenderPass.h"
+#include "MultisampleFbo.h"
+
+namespace itg
+{
+    /*
+     * Replaces a run of colour mapping passes with one 3D LUT lookup. The
+     * passes themselves render an identity LUT laid out as a strip of
+     * slices, so the bake matches their shaders exactly, and the strip is
+     * copied into a 3D texture. update() only bakes again when the passes or
+     * their parameters change. Input colours are clamped to 0-1 and baking
+     * assumes opaque pixels, see RenderPass::isColorMapping().
+     */
+    class ColorBake
+    {
+    public:
+        typedef shared_ptr<ColorBake> Ptr;
+        
+        // sizes above 64 would make the strip wider than older gpus allow
+        static const unsigned MAX_SIZE = 64;
+        
+        ColorBake(unsigned size = 33);
+        ~ColorBake();
+        
+        // bakes the passes in order if they've changed since the last call
+        void update(const vector<RenderPass*>& passes);
+        
+        void render(ofFbo& readFbo, ofFbo& writeFbo, bool lumaToAlpha);
+        
+        // reads the samples directly, grading each before averaging them, in
+        // place of a resolve and then a lookup. writeFbo has to be the same size.
+        void render(MultisampleFbo& multisampleFbo, ofFbo& writeFbo, bool lumaToAlpha);
+        
+        unsigned getSize() const { return size; }
+        void setSize(unsigned size);
+        
+        unsigned getNumBakes() const { return numBakes; }
+        GLuint getTextureId() const { return lut; }
+        
+    private:
+        void bake(const vector<RenderPass*>& passes);
+        
+        ofShader identityShader;
+        ofShader shader;
+        ofShader multisampleShader;
+        ofFbo strip[2];
+        ofTexture noDepth;
+        GLuint lut;
+        unsigned size;
+        unsigned numBakes;
+        
+        vector<RenderPass*> bakedPasses;
+        vector<float> bakedParameters;
+    };
+}
@@ -54,10 +54,11 @@ namespace itg
                                              color = mix( vec4(1.0,1.0,1.0,1.0),color,contrast);
                                              
                                              gl_FragColor =  vec4(color.r , color.g, color.b, 1.0);
+                                             gl_FragColor = applyLumaToAlpha(gl_FragColor);
                                          }
                                          );
         
-        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
+        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, getLumaToAlphaSrc() + fragShaderSrc);
         shader.linkProgram();
         
     }
@@ -65,7 +66,7 @@ namespace itg
 
     void ContrastPass::render(ofFbo& readFbo, ofFbo& writeFbo)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         ofClear(0, 0, 0, 255);
         
@@ -75,10 +76,11 @@ namespace itg
         shader.setUniform1f("contrast", contrast);
         shader.setUniform1f("brightness", brightness);
         shader.setUniform1f("multiple", multiple);
+        shader.setUniform1i("lumaToAlpha", writeLumaToAlpha ? 1 : 0);
         
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
\ No newline at end of file
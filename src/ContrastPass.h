@@ -55,6 +55,16 @@ namespace itg
         
         float getMultiple() { return multiple; }
         void setMultiple(float val) { multiple = val; }
+
+        bool canWriteLumaToAlpha() const { return true; }
+        
+        bool isColorMapping() const { return true; }
+        void getParameters(vector<float>& parameters) const
+        {
+            parameters.push_back(contrast);
+            parameters.push_back(brightness);
+            parameters.push_back(multiple);
+        }
     private:
         
         ofShader shader;
@@ -34,9 +34,20 @@
 
 namespace itg
 {
+    map<ConvolutionPass::ProgramKey, weak_ptr<ofShader> > ConvolutionPass::programs;
+    
     ConvolutionPass::ConvolutionPass(const ofVec2f& aspect, bool arb, const ofVec2f& imageIncrement, float sigma, unsigned kernelSize) :
-        imageIncrement(imageIncrement), RenderPass(aspect, arb, "convolution")
+        imageIncrement(imageIncrement), maxKernelSize(kernelSize), threshold(0.f), knee(0.1f), RenderPass(aspect, arb, "convolution")
+    {
+        setSigma(sigma);
+    }
+    
+    shared_ptr<ofShader> ConvolutionPass::getProgram(unsigned numPairs, bool arb, bool prefilter)
     {
+        ProgramKey key(numPairs, arb, prefilter);
+        shared_ptr<ofShader> program = programs[key].lock();
+        if (program) return program;
+        
         string vertShaderSrc = STRINGIFY(
             uniform vec2 imageIncrement;
             uniform vec2 resolution;
@@ -48,41 +59,60 @@ namespace itg
             {
                 gl_TexCoord[0] = gl_MultiTexCoord0;
                 scaledImageIncrement = imageIncrement * resolution;
-                vUv = gl_TexCoord[0].st - ( ( KERNEL_SIZE - 1.0 ) / 2.0 ) * scaledImageIncrement;
+                vUv = gl_TexCoord[0].st;
                 gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
             }
         );
         
         string fragShaderSrc = STRINGIFY(
-            uniform float kernel[KERNEL_SIZE];
+            uniform float weights[NUM_PAIRS + 1];
+            uniform float offsets[OFFSETS_SIZE];
             uniform SAMPLER_TYPE readTex;
-            uniform vec2 imageIncrement;
+            // threshold, threshold - knee, 2 * knee, 0.25 / knee
+            uniform vec4 curve;
             
             varying vec2 vUv;
             varying vec2 scaledImageIncrement;
+            
+            vec4 fetch( vec2 coord )
+            {
+                vec4 c = TEXTURE_FN( readTex, coord );
+                if ( PREFILTER )
+                {
+                    float br = max( c.r, max( c.g, c.b ) );
+                    float rq = clamp( br - curve.y, 0.0, curve.z );
+                    rq = curve.w * rq * rq;
+                    c.rgb *= max( rq, br - curve.x ) / max( br, 1.0e-4 );
+                }
+                return c;
+            }
                                          
             void main()
             {
-            
-                vec2 imageCoord = vUv;
-                vec4 sum = vec4( 0.0, 0.0, 0.0, 0.0 );
+                vec4 sum = fetch( vUv ) * weights[ 0 ];
                 
-                for( int i = 0; i < KERNEL_SIZE; i++ )
+                for( int i = 0; i < NUM_PAIRS; i++ )
                 {
-                    sum += TEXTURE_FN( readTex, imageCoord ) * kernel[ i ];
-                    imageCoord += scaledImageIncrement;
+                    vec2 offset = offsets[ i ] * scaledImageIncrement;
+                    sum += ( fetch( vUv + offset ) + fetch( vUv - offset ) ) * weights[ i + 1 ];
                 }
                 
                 gl_FragColor = sum;
             }
         );
         
+        program = shared_ptr<ofShader>(new ofShader());
+        
         ostringstream oss;
-        oss << "#version 120\n#define KERNEL_SIZE " << kernelSize << ".0" << endl << vertShaderSrc;
-        shader.setupShaderFromSource(GL_VERTEX_SHADER, oss.str());
+        oss << "#version 120" << endl << vertShaderSrc;
+        program->setupShaderFromSource(GL_VERTEX_SHADER, oss.str());
         
         oss.str("");
-        oss << "#version 120\n#define KERNEL_SIZE " << kernelSize << endl;
+        oss << "#version 120" << endl;
+        oss << "#define NUM_PAIRS " << numPairs << endl;
+        // glsl doesn't allow zero sized arrays
+        oss << "#define OFFSETS_SIZE " << max(numPairs, 1u) << endl;
+        oss << "#define PREFILTER " << (prefilter ? "true" : "false") << endl;
         if (arb)
         {
             oss << "#define SAMPLER_TYPE sampler2DRect" << endl;
@@ -94,11 +124,26 @@ namespace itg
             oss << "#define TEXTURE_FN texture2D" << endl;
         }
         oss << fragShaderSrc;
-        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, oss.str());
-        shader.linkProgram();
+        program->setupShaderFromSource(GL_FRAGMENT_SHADER, oss.str());
+        program->linkProgram();
         
-        // build kernel
+        programs[key] = program;
+        return program;
+    }
+    
+    void ConvolutionPass::setSigma(float sigma)
+    {
+        this->sigma = sigma;
         buildKernel(sigma);
+        shader = getProgram(offsets.size(), arb, threshold > 0.f);
+    }
+    
+    void ConvolutionPass::setThreshold(float threshold, float knee)
+    {
+        bool changed = (threshold > 0.f) != (this->threshold > 0.f);
+        this->threshold = threshold;
+        this->knee = knee;
+        if (changed) shader = getProgram(offsets.size(), arb, threshold > 0.f);
     }
     
     // We lop off the sqrt(2 * pi) * sigma term, since we're going to normalize anyway.
@@ -109,47 +154,77 @@ namespace itg
 
     void ConvolutionPass::render(ofFbo& readFbo, ofFbo& writeFbo)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         ofClear(0, 0, 0, 255);
         
-        shader.begin();
+        shader->begin();
         
-        shader.setUniformTexture("readTex", readFbo, 0);
-        shader.setUniform2f("imageIncrement", imageIncrement.x, imageIncrement.y);
-        shader.setUniform1fv("kernel", kernel.data(), kernel.size());
-        if (arb) shader.setUniform2f("resolution", readFbo.getWidth(), readFbo.getHeight());
-        else shader.setUniform2f("resolution", 1.f, 1.f);
+        shader->setUniformTexture("readTex", readFbo, 0);
+        shader->setUniform2f("imageIncrement", imageIncrement.x, imageIncrement.y);
+        shader->setUniform1fv("weights", weights.data(), weights.size());
+        if (!offsets.empty()) shader->setUniform1fv("offsets", offsets.data(), offsets.size());
+        if (threshold > 0.f)
+        {
+            float k = max(knee, 1e-5f);
+            shader->setUniform4f("curve", threshold, threshold - k, 2.f * k, 0.25f / k);
+        }
+        if (arb) shader->setUniform2f("resolution", readFbo.getWidth(), readFbo.getHeight());
+        else shader->setUniform2f("resolution", 1.f, 1.f);
         
         if (arb) texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight(), readFbo.getWidth(), readFbo.getHeight());
         else texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
-        shader.end();
-        writeFbo.end();
+        shader->end();
+        endTarget(writeFbo);
     }
     
     void ConvolutionPass::buildKernel(float sigma)
     {
         unsigned kernelSize = 2 * ceil( sigma * 3.0 ) + 1;
         
+        if (kernelSize > maxKernelSize) kernelSize = maxKernelSize;
         if (kernelSize > MAX_KERNEL_SIZE) kernelSize = MAX_KERNEL_SIZE;
+        // kernel needs a centre tap
+        if (kernelSize % 2 == 0) --kernelSize;
         
-        kernel.clear();
-        kernel.reserve(kernelSize);
+        unsigned halfWidth = kernelSize / 2;
         
-        float halfWidth = ( kernelSize - 1 ) * 0.5;
+        // the kernel is symmetric so only build the centre and one side
+        vector<float> kernel;
+        kernel.reserve(halfWidth + 1);
         
         float sum = 0.0;
-        for (unsigned i = 0; i < kernelSize; ++i )
+        for (unsigned i = 0; i <= halfWidth; ++i )
         {
-            kernel.push_back(gauss(i - halfWidth, sigma));
-            sum += kernel.back();
+            kernel.push_back(gauss(i, sigma));
+            sum += i == 0 ? kernel.back() : 2.0 * kernel.back();
         }
         
         // normalize the kernel
-        for (unsigned i = 0; i < kernelSize; ++i )
+        for (unsigned i = 0; i <= halfWidth; ++i )
         {
             kernel[ i ] /= sum;
         }
+        
+        // merge neighbouring taps into one bilinear fetch at their weighted centre,
+        // if the half width is odd the outermost tap is left on its own
+        weights.clear();
+        offsets.clear();
+        weights.push_back(kernel[0]);
+        for (unsigned i = 1; i <= halfWidth; i += 2)
+        {
+            if (i + 1 <= halfWidth)
+            {
+                float weight = kernel[i] + kernel[i + 1];
+                weights.push_back(weight);
+                offsets.push_back((i * kernel[i] + (i + 1) * kernel[i + 1]) / weight);
+            }
+            else
+            {
+                weights.push_back(kernel[i]);
+                offsets.push_back(i);
+            }
+        }
     }
 }
\ No newline at end of file
@@ -38,6 +38,11 @@ namespace itg
 {
     /*
      * @see http://github.com/mrdoob/three.js/blob/master/examples/js/ShaderExtras.js 
+     *
+     * Separable gaussian blur using linear sampling, i.e. pairs of neighbouring
+     * kernel weights are merged into a single bilinear fetch placed between them
+     * so a kernel of n weights only needs (n + 1) / 2 texture reads.
+     * @see http://rastergrid.com/blog/2010/09/efficient-gaussian-blur-with-linear-sampling/
      */
     class ConvolutionPass : public RenderPass
     {
@@ -46,17 +51,55 @@ namespace itg
         
         typedef shared_ptr<ConvolutionPass> Ptr;
         
-        ConvolutionPass(const ofVec2f& aspect, bool arb, const ofVec2f& imageIncrement = ofVec2f(0.001953125, 0), float sigma = 4, unsigned kernelSize = 25);
+        // kernelSize is the maximum kernel size, the actual size is derived from sigma
+        ConvolutionPass(const ofVec2f& aspect, bool arb, const ofVec2f& imageIncrement = ofVec2f(0.001953125, 0), float sigma = 4, unsigned kernelSize = MAX_KERNEL_SIZE);
         
         void render(ofFbo& readFbo, ofFbo& writeFbo);
         
         bool hasArbShader() { return true; }
+        
+        float getSigma() const { return sigma; }
+        void setSigma(float sigma);
+        
+        ofVec2f getImageIncrement() const { return imageIncrement; }
+        void setImageIncrement(const ofVec2f& imageIncrement) { this->imageIncrement = imageIncrement; }
+        
+        // number of texture fetches per pixel
+        unsigned getNumTaps() const { return 1 + 2 * offsets.size(); }
+        
+        // the merged taps, see below
+        const vector<float>& getWeights() const { return weights; }
+        const vector<float>& getOffsets() const { return offsets; }
+        
+        /*
+         * Only let through the part of each tap that is brighter than threshold
+         * with a soft transition of width knee, used as a bright pass for bloom.
+         * A threshold of zero disables it.
+         */
+        void setThreshold(float threshold, float knee = 0.1f);
+        float getThreshold() const { return threshold; }
+        float getKnee() const { return knee; }
     
     private:
+        // number of merged taps, arb, threshold
+        typedef tuple<unsigned, bool, bool> ProgramKey;
+        
+        // programs are shared between all convolution passes with the same number of taps
+        static shared_ptr<ofShader> getProgram(unsigned numPairs, bool arb, bool prefilter);
+        static map<ProgramKey, weak_ptr<ofShader> > programs;
+        
         float gauss(float x, float sigma);
         void buildKernel(float sigma);
-        vector<float> kernel;
-        ofShader shader;
+        
+        // weight of the centre tap followed by the weights of the merged taps on one side
+        vector<float> weights;
+        // offsets of the merged taps on one side in units of imageIncrement
+        vector<float> offsets;
+        shared_ptr<ofShader> shader;
         ofVec2f imageIncrement;
+        unsigned maxKernelSize;
+        float sigma;
+        float threshold;
+        float knee;
     };
 }
\ No newline at end of file
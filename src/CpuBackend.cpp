@@ -0,0 +1,737 @@
+/*
+ *  CpuBackend.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "CpuBackend.h"
+#include "ConvolutionPass.h"
+#include "BloomPass.h"
+#include "ContrastPass.h"
+#include "HsbShiftPass.h"
+#include "BleachBypassPass.h"
+#include "LUTPass.h"
+#include "PixelatePass.h"
+#include "RGBShiftPass.h"
+#include "FxaaPass.h"
+#include "EdgePass.h"
+#include "LimbDarkeningPass.h"
+#include <thread>
+
+namespace itg
+{
+    // each function below follows its pass's fragment shader, u and v are the
+    // centre of the pixel in texture coordinates like gl_TexCoord[0]
+    namespace
+    {
+        float fract(float x)
+        {
+            return x - floorf(x);
+        }
+        
+        float clampf(float x, float lo, float hi)
+        {
+            return min(max(x, lo), hi);
+        }
+        
+        Float4 brightPass(const Float4& c, float threshold, float knee)
+        {
+            float k = max(knee, 1e-5f);
+            float br = max(c[0], max(c[1], c[2]));
+            float rq = clampf(br - (threshold - k), 0.f, 2.f * k);
+            rq = 0.25f / k * rq * rq;
+            float scale = max(rq, br - threshold) / max(br, 1.0e-4f);
+            return c * Float4(scale, scale, scale, 1.f);
+        }
+        
+        void convolve(const CpuImage& src, CpuImage& dst, const CpuBackend::ConvolutionParameters& p, const TileScheduler::Tile& tile)
+        {
+            const vector<float>& weights = p.weights;
+            const vector<float>& offsets = p.offsets;
+            const ofVec2f increment = p.increment;
+            const float threshold = p.threshold;
+            const float knee = p.knee;
+            
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                float v = (y + 0.5f) / src.getHeight();
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    float u = (x + 0.5f) / src.getWidth();
+                    Float4 c = src.fetch(x, y);
+                    if (threshold > 0.f) c = brightPass(c, threshold, knee);
+                    Float4 sum = c * weights[0];
+                    for (unsigned i = 0; i < offsets.size(); ++i)
+                    {
+                        float ou = offsets[i] * increment.x;
+                        float ov = offsets[i] * increment.y;
+                        Float4 a = src.sample(u + ou, v + ov);
+                        Float4 b = src.sample(u - ou, v - ov);
+                        if (threshold > 0.f)
+                        {
+                            a = brightPass(a, threshold, knee);
+                            b = brightPass(b, threshold, knee);
+                        }
+                        sum += (a + b) * weights[i + 1];
+                    }
+                    sum.store(out + 4 * x);
+                }
+            }
+        }
+        
+        void bloomComposite(const CpuImage& scene, const CpuImage& bloom, CpuImage& dst, float intensity, const TileScheduler::Tile& tile)
+        {
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    Float4 c = scene.fetch(x, y) + bloom.fetch(x, y) * Float4(intensity, intensity, intensity, 0.f);
+                    Float4(c[0], c[1], c[2], 1.f).store(out + 4 * x);
+                }
+            }
+        }
+        
+        void contrast(const CpuImage& src, CpuImage& dst, const CpuBackend::ContrastParameters& p, const TileScheduler::Tile& tile)
+        {
+            const float contrast = p.contrast;
+            const float brightness = p.brightness;
+            const float multiple = p.multiple;
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    Float4 color = src.fetch(x, y);
+                    float p = dot3(color, 0.59f, 0.3f, 0.11f) * brightness;
+                    color *= Float4(p * multiple, p * multiple, p * multiple, 1.f);
+                    color = mix(Float4(1.f), color, contrast);
+                    Float4(color[0], color[1], color[2], 1.f).store(out + 4 * x);
+                }
+            }
+        }
+        
+        void hsbShift(const CpuImage& src, CpuImage& dst, const CpuBackend::HsbShiftParameters& pass, const TileScheduler::Tile& tile)
+        {
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    float c[4];
+                    src.fetch(x, y).store(c);
+                    
+                    // rgbToHsb
+                    bool gb = c[2] <= c[1];
+                    float p[4] = { gb ? c[1] : c[2], gb ? c[2] : c[1], gb ? 0.f : -1.f, gb ? -1.f / 3.f : 2.f / 3.f };
+                    bool pr = p[0] <= c[0];
+                    float q[4] = { pr ? c[0] : p[0], p[1], pr ? p[2] : p[3], pr ? p[0] : c[0] };
+                    float d = q[0] - min(q[3], q[1]);
+                    float e = 1.0e-10f;
+                    float h = fabsf(q[2] + (q[3] - q[1]) / (6.f * d + e)) + pass.hueShift;
+                    float s = d / (q[0] + e) + pass.saturationShift;
+                    float b = q[0] + pass.brightnessShift;
+                    
+                    // hsbToRgb
+                    float rgb[3];
+                    for (unsigned i = 0; i < 3; ++i)
+                    {
+                        float k = clampf(fabsf(fract(h + (3.f - i) / 3.f) * 6.f - 3.f) - 1.f, 0.f, 1.f);
+                        rgb[i] = (1.f + (k - 1.f) * s) * b;
+                    }
+                    Float4(rgb[0], rgb[1], rgb[2], 1.f).store(out + 4 * x);
+                }
+            }
+        }
+        
+        void bleachBypass(const CpuImage& src, CpuImage& dst, const CpuBackend::BleachBypassParameters& p, const TileScheduler::Tile& tile)
+        {
+            const float opacity = p.opacity;
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    Float4 base = src.fetch(x, y);
+                    float lum = dot3(base, 0.25f, 0.65f, 0.1f);
+                    float L = clampf(10.f * (lum - 0.45f), 0.f, 1.f);
+                    Float4 result1 = base * (2.f * lum);
+                    Float4 result2 = Float4(1.f) - (Float4(1.f) - base) * (2.f * (1.f - lum));
+                    Float4 newColor = mix(result1, result2, L);
+                    float a2 = opacity * base[3];
+                    Float4 mixRGB = newColor * a2 + base * (1.f - a2);
+                    Float4(mixRGB[0], mixRGB[1], mixRGB[2], base[3]).store(out + 4 * x);
+                }
+            }
+        }
+        
+        Float4 lutFetch(const vector<float>& lut, int size, int r, int g, int b)
+        {
+            r = min(max(r, 0), size - 1);
+            g = min(max(g, 0), size - 1);
+            b = min(max(b, 0), size - 1);
+            const float* p = &lut[3 * ((b * size + g) * size + r)];
+            return Float4(p[0], p[1], p[2], 0.f);
+        }
+        
+        void lut(const CpuImage& src, CpuImage& dst, const CpuBackend::LUTParameters& p, const TileScheduler::Tile& tile)
+        {
+            const vector<float>& lut = p.data;
+            const int size = p.size;
+            const ofVec3f domainMin = p.domainMin;
+            const ofVec3f domainMax = p.domainMax;
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    Float4 c = src.fetch(x, y);
+                    float t[3];
+                    int i[3];
+                    for (unsigned k = 0; k < 3; ++k)
+                    {
+                        float coord = clampf((c[k] - domainMin[k]) / (domainMax[k] - domainMin[k]), 0.f, 0.98f) * size - 0.5f;
+                        i[k] = floorf(coord);
+                        t[k] = coord - i[k];
+                    }
+                    Float4 c00 = mix(lutFetch(lut, size, i[0], i[1], i[2]), lutFetch(lut, size, i[0] + 1, i[1], i[2]), t[0]);
+                    Float4 c10 = mix(lutFetch(lut, size, i[0], i[1] + 1, i[2]), lutFetch(lut, size, i[0] + 1, i[1] + 1, i[2]), t[0]);
+                    Float4 c01 = mix(lutFetch(lut, size, i[0], i[1], i[2] + 1), lutFetch(lut, size, i[0] + 1, i[1], i[2] + 1), t[0]);
+                    Float4 c11 = mix(lutFetch(lut, size, i[0], i[1] + 1, i[2] + 1), lutFetch(lut, size, i[0] + 1, i[1] + 1, i[2] + 1), t[0]);
+                    Float4 result = mix(mix(c00, c10, t[1]), mix(c01, c11, t[1]), t[2]);
+                    Float4(result[0], result[1], result[2], c[3]).store(out + 4 * x);
+                }
+            }
+        }
+        
+        void pixelate(const CpuImage& src, CpuImage& dst, const CpuBackend::PixelateParameters& p, const TileScheduler::Tile& tile)
+        {
+            const ofVec2f resolution = p.resolution;
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                float v = floorf((y + 0.5f) / src.getHeight() * resolution.y) / resolution.y;
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    float u = floorf((x + 0.5f) / src.getWidth() * resolution.x) / resolution.x;
+                    src.sample(u, v).store(out + 4 * x);
+                }
+            }
+        }
+        
+        void rgbShift(const CpuImage& src, CpuImage& dst, const CpuBackend::RGBShiftParameters& p, const TileScheduler::Tile& tile)
+        {
+            const float ou = p.amount * cosf(p.angle);
+            const float ov = p.amount * sinf(p.angle);
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                float v = (y + 0.5f) / src.getHeight();
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    float u = (x + 0.5f) / src.getWidth();
+                    Float4 cga = src.fetch(x, y);
+                    Float4(src.sample(u + ou, v + ov)[0], cga[1], src.sample(u - ou, v - ov)[2], cga[3]).store(out + 4 * x);
+                }
+            }
+        }
+        
+        void fxaa(const CpuImage& src, CpuImage& dst, const CpuBackend::FxaaParameters& p, const TileScheduler::Tile& tile)
+        {
+            const float spanMax = p.spanMax, reduceMul = p.reduceMul, edgeThreshold = p.edgeThreshold, edgeThresholdMin = p.edgeThresholdMin;
+            const bool twoTap = p.twoTap;
+            const float reduceMin = 1.f / 128.f;
+            const float rw = 1.f / src.getWidth();
+            const float rh = 1.f / src.getHeight();
+            
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    float u = (x + 0.5f) * rw;
+                    float v = (y + 0.5f) * rh;
+                    Float4 rgbaM = src.fetch(x, y);
+                    float lumaNW = dot3(src.fetch(x - 1, y - 1), 0.299f, 0.587f, 0.114f);
+                    float lumaNE = dot3(src.fetch(x + 1, y - 1), 0.299f, 0.587f, 0.114f);
+                    float lumaSW = dot3(src.fetch(x - 1, y + 1), 0.299f, 0.587f, 0.114f);
+                    float lumaSE = dot3(src.fetch(x + 1, y + 1), 0.299f, 0.587f, 0.114f);
+                    float lumaM = dot3(rgbaM, 0.299f, 0.587f, 0.114f);
+                    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+                    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+                    
+                    if (edgeThreshold > 0.f && lumaMax - lumaMin < max(edgeThresholdMin, lumaMax * edgeThreshold))
+                    {
+                        rgbaM.store(out + 4 * x);
+                        continue;
+                    }
+                    
+                    float dirX = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+                    float dirY = ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+                    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25f * reduceMul), reduceMin);
+                    float rcpDirMin = 1.f / (min(fabsf(dirX), fabsf(dirY)) + dirReduce);
+                    dirX = clampf(dirX * rcpDirMin, -spanMax, spanMax) * rw;
+                    dirY = clampf(dirY * rcpDirMin, -spanMax, spanMax) * rh;
+                    
+                    Float4 rgbaA = (src.sample(u + dirX * (1.f / 3.f - 0.5f), v + dirY * (1.f / 3.f - 0.5f)) +
+                                    src.sample(u + dirX * (2.f / 3.f - 0.5f), v + dirY * (2.f / 3.f - 0.5f))) * 0.5f;
+                    Float4 result = rgbaA;
+                    if (!twoTap)
+                    {
+                        Float4 rgbaB = rgbaA * 0.5f + (src.sample(u - dirX * 0.5f, v - dirY * 0.5f) +
+                                                       src.sample(u + dirX * 0.5f, v + dirY * 0.5f)) * 0.25f;
+                        float lumaB = dot3(rgbaB, 0.299f, 0.587f, 0.114f);
+                        if (lumaB >= lumaMin && lumaB <= lumaMax) result = rgbaB;
+                    }
+                    Float4(result[0], result[1], result[2], rgbaM[3]).store(out + 4 * x);
+                }
+            }
+        }
+        
+        void edge(const CpuImage& src, CpuImage& dst, const CpuBackend::EdgeParameters& pass, const TileScheduler::Tile& tile)
+        {
+            // columns of the glsl mat3s
+            static const float G[9][9] = {
+                { 0.3535533845424652f, 0.f, -0.3535533845424652f, 0.5f, 0.f, -0.5f, 0.3535533845424652f, 0.f, -0.3535533845424652f },
+                { 0.3535533845424652f, 0.5f, 0.3535533845424652f, 0.f, 0.f, 0.f, -0.3535533845424652f, -0.5f, -0.3535533845424652f },
+                { 0.f, 0.3535533845424652f, -0.5f, -0.3535533845424652f, 0.f, 0.3535533845424652f, 0.5f, -0.3535533845424652f, 0.f },
+                { 0.5f, -0.3535533845424652f, 0.f, -0.3535533845424652f, 0.f, 0.3535533845424652f, 0.f, 0.3535533845424652f, -0.5f },
+                { 0.f, -0.5f, 0.f, 0.5f, 0.f, 0.5f, 0.f, -0.5f, 0.f },
+                { -0.5f, 0.f, 0.5f, 0.f, 0.f, 0.f, 0.5f, 0.f, -0.5f },
+                { 0.1666666716337204f, -0.3333333432674408f, 0.1666666716337204f, -0.3333333432674408f, 0.6666666865348816f, -0.3333333432674408f, 0.1666666716337204f, -0.3333333432674408f, 0.1666666716337204f },
+                { -0.3333333432674408f, 0.1666666716337204f, -0.3333333432674408f, 0.1666666716337204f, 0.6666666865348816f, 0.1666666716337204f, -0.3333333432674408f, 0.1666666716337204f, -0.3333333432674408f },
+                { 0.3333333432674408f, 0.3333333432674408f, 0.3333333432674408f, 0.3333333432674408f, 0.3333333432674408f, 0.3333333432674408f, 0.3333333432674408f, 0.3333333432674408f, 0.3333333432674408f } };
+            
+            float color[3];
+            for (unsigned i = 0; i < 3; ++i)
+            {
+                float k = clampf(fabsf(fract(pass.hue + (3.f - i) / 3.f) * 6.f - 3.f) - 1.f, 0.f, 1.f);
+                color[i] = 1.f + (k - 1.f) * pass.saturation;
+            }
+            
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    // I[column][row] is the intensity at (x + column - 1, y + row - 1)
+                    float I[9];
+                    for (unsigned c = 0; c < 3; ++c)
+                    {
+                        for (unsigned r = 0; r < 3; ++r)
+                        {
+                            Float4 s = src.fetch(x + c - 1, y + r - 1);
+                            I[3 * c + r] = sqrtf(dot3(s * s, 1.f, 1.f, 1.f));
+                        }
+                    }
+                    float cnv[9];
+                    for (unsigned i = 0; i < 9; ++i)
+                    {
+                        float dp3 = 0.f;
+                        for (unsigned j = 0; j < 9; ++j) dp3 += G[i][j] * I[j];
+                        cnv[i] = dp3 * dp3;
+                    }
+                    float M = (cnv[0] + cnv[1]) + (cnv[2] + cnv[3]);
+                    float S = (cnv[4] + cnv[5]) + (cnv[6] + cnv[7]) + (cnv[8] + M);
+                    float value = sqrtf(M / S);
+                    Float4(color[0] * value, color[1] * value, color[2] * value, 1.f).store(out + 4 * x);
+                }
+            }
+        }
+        
+        // LimbDarkeningPass::render() currently sets fixed uniforms rather than
+        // its parameters so these are the same fixed values
+        void limbDarkening(const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile)
+        {
+            const float radialScale = 1.2f;
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                float* out = dst.getRow(y);
+                float dy = (y + 0.5f) / src.getHeight() - 0.5f;
+                for (unsigned x = tile.x0; x < tile.x1; ++x)
+                {
+                    float dx = (x + 0.5f) / src.getWidth() - 0.5f;
+                    float prop = sqrtf(dx * dx + dy * dy) / radialScale;
+                    prop = clampf(2.5f * powf(1.f - prop, 3.f), 0.f, 1.f);
+                    // mix(startColor = 1, endColor = 0, 1 - prop)
+                    Float4 c = src.fetch(x, y) * prop;
+                    Float4(c[0], c[1], c[2], 1.f).store(out + 4 * x);
+                }
+            }
+        }
+        
+        void copy(const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile)
+        {
+            for (unsigned y = tile.y0; y < tile.y1; ++y)
+            {
+                memcpy(dst.getRow(y) + 4 * tile.x0, src.getRow(y) + 4 * tile.x0, 4 * sizeof(float) * (tile.x1 - tile.x0));
+            }
+        }
+    }
+    
+    CpuBackend::CpuBackend(unsigned numThreads) : tiled(false)
+    {
+        setNumThreads(numThreads);
+    }
+    
+    void CpuBackend::setNumThreads(unsigned numThreads)
+    {
+        if (numThreads == 0) numThreads = thread::hardware_concurrency();
+        this->numThreads = max(numThreads, 1u);
+        scheduler.setNumThreads(this->numThreads);
+    }
+    
+    void CpuBackend::parallelTiles(unsigned width, unsigned height, const TileScheduler::Kernel& fn)
+    {
+        scheduler.clear();
+        scheduler.addStage(fn, vector<TileScheduler::Input>(1, TileScheduler::Input(TileScheduler::SOURCE)));
+        scheduler.run(width, height);
+    }
+    
+    bool CpuBackend::getPass(RenderPass& pass, Pass& out)
+    {
+        if (ConvolutionPass* p = dynamic_cast<ConvolutionPass*>(&pass))
+        {
+            out.type = Pass::CONVOLUTION;
+            out.convolution.weights = p->getWeights();
+            out.convolution.offsets = p->getOffsets();
+            out.convolution.increment = p->getImageIncrement();
+            out.convolution.threshold = p->getThreshold();
+            out.convolution.knee = p->getKnee();
+            return true;
+        }
+        if (BloomPass* p = dynamic_cast<BloomPass*>(&pass))
+        {
+            out.type = Pass::BLOOM;
+            ConvolutionPass* convolutions[2] = { p->getXConvolution().get(), p->getYConvolution().get() };
+            ConvolutionParameters* parameters[2] = { &out.bloom.x, &out.bloom.y };
+            for (unsigned i = 0; i < 2; ++i)
+            {
+                parameters[i]->weights = convolutions[i]->getWeights();
+                parameters[i]->offsets = convolutions[i]->getOffsets();
+                parameters[i]->increment = convolutions[i]->getImageIncrement();
+                parameters[i]->threshold = 0.f;
+            }
+            // the gpu version sets this on its x blur when it renders
+            out.bloom.x.threshold = p->getThreshold();
+            out.bloom.x.knee = p->getKnee();
+            out.bloom.intensity = p->getIntensity();
+            return true;
+        }
+        if (ContrastPass* p = dynamic_cast<ContrastPass*>(&pass))
+        {
+            out.type = Pass::CONTRAST;
+            out.contrast.contrast = p->getContrast();
+            out.contrast.brightness = p->getBrightness();
+            out.contrast.multiple = p->getMultiple();
+            return true;
+        }
+        if (HsbShiftPass* p = dynamic_cast<HsbShiftPass*>(&pass))
+        {
+            out.type = Pass::HSB_SHIFT;
+            out.hsbShift.hueShift = p->getHueShift();
+            out.hsbShift.saturationShift = p->getSaturationShift();
+            out.hsbShift.brightnessShift = p->getBrightnessShift();
+            return true;
+        }
+        if (BleachBypassPass* p = dynamic_cast<BleachBypassPass*>(&pass))
+        {
+            out.type = Pass::BLEACH_BYPASS;
+            out.bleachBypass.opacity = p->getOpacity();
+            return true;
+        }
+        if (LUTPass* p = dynamic_cast<LUTPass*>(&pass))
+        {
+            out.type = Pass::LUT;
+            out.lut.data = p->getLUTData();
+            out.lut.size = p->getLUTSize();
+            out.lut.domainMin = p->getDomainMin();
+            out.lut.domainMax = p->getDomainMax();
+            return true;
+        }
+        if (PixelatePass* p = dynamic_cast<PixelatePass*>(&pass))
+        {
+            out.type = Pass::PIXELATE;
+            out.pixelate.resolution = p->getResolution();
+            return true;
+        }
+        if (RGBShiftPass* p = dynamic_cast<RGBShiftPass*>(&pass))
+        {
+            out.type = Pass::RGB_SHIFT;
+            out.rgbShift.amount = p->getAmount();
+            out.rgbShift.angle = p->getAngle();
+            return true;
+        }
+        if (FxaaPass* p = dynamic_cast<FxaaPass*>(&pass))
+        {
+            out.type = Pass::FXAA;
+            out.fxaa = FxaaParameters();
+            if (p->getQuality() == FxaaPass::QUALITY_LOW)
+            {
+                out.fxaa.spanMax = 4.f;
+                out.fxaa.reduceMul = 1.f / 4.f;
+                out.fxaa.edgeThreshold = 1.f / 4.f;
+                out.fxaa.edgeThresholdMin = 1.f / 12.f;
+                out.fxaa.twoTap = true;
+            }
+            else if (p->getQuality() == FxaaPass::QUALITY_MEDIUM)
+            {
+                out.fxaa.edgeThreshold = 1.f / 8.f;
+                out.fxaa.edgeThresholdMin = 1.f / 16.f;
+            }
+            return true;
+        }
+        if (EdgePass* p = dynamic_cast<EdgePass*>(&pass))
+        {
+            out.type = Pass::EDGE;
+            out.edge.hue = p->getHue();
+            out.edge.saturation = p->getSaturation();
+            return true;
+        }
+        if (dynamic_cast<LimbDarkeningPass*>(&pass))
+        {
+            out.type = Pass::LIMB_DARKENING;
+            return true;
+        }
+        return false;
+    }
+    
+    bool CpuBackend::isSupported(RenderPass& pass)
+    {
+        return dynamic_cast<ConvolutionPass*>(&pass) || dynamic_cast<BloomPass*>(&pass) || dynamic_cast<ContrastPass*>(&pass) ||
+            dynamic_cast<HsbShiftPass*>(&pass) || dynamic_cast<BleachBypassPass*>(&pass) || dynamic_cast<LUTPass*>(&pass) ||
+            dynamic_cast<PixelatePass*>(&pass) || dynamic_cast<RGBShiftPass*>(&pass) || dynamic_cast<FxaaPass*>(&pass) ||
+            dynamic_cast<EdgePass*>(&pass) || dynamic_cast<LimbDarkeningPass*>(&pass);
+    }
+    
+    CpuBackend::Kernel CpuBackend::getKernel(const Pass& pass)
+    {
+        const Pass* p = &pass;
+        switch (pass.type)
+        {
+            case Pass::CONVOLUTION:
+                return [p](const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile) { convolve(src, dst, p->convolution, tile); };
+            case Pass::CONTRAST:
+                return [p](const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile) { contrast(src, dst, p->contrast, tile); };
+            case Pass::HSB_SHIFT:
+                return [p](const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile) { hsbShift(src, dst, p->hsbShift, tile); };
+            case Pass::BLEACH_BYPASS:
+                return [p](const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile) { bleachBypass(src, dst, p->bleachBypass, tile); };
+            case Pass::LUT:
+                if (p->lut.data.empty()) return copy;
+                return [p](const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile) { lut(src, dst, p->lut, tile); };
+            case Pass::PIXELATE:
+                return [p](const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile) { pixelate(src, dst, p->pixelate, tile); };
+            case Pass::RGB_SHIFT:
+                return [p](const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile) { rgbShift(src, dst, p->rgbShift, tile); };
+            case Pass::FXAA:
+                return [p](const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile) { fxaa(src, dst, p->fxaa, tile); };
+            case Pass::EDGE:
+                return [p](const CpuImage& src, CpuImage& dst, const TileScheduler::Tile& tile) { edge(src, dst, p->edge, tile); };
+            case Pass::LIMB_DARKENING:
+                return limbDarkening;
+            default:
+                return Kernel();
+        }
+    }
+    
+    void CpuBackend::getHalo(const ConvolutionParameters& convolution, unsigned width, unsigned height, unsigned& haloX, unsigned& haloY)
+    {
+        float maxOffset = convolution.offsets.empty() ? 0.f : *max_element(convolution.offsets.begin(), convolution.offsets.end());
+        haloX = ceilf(maxOffset * fabsf(convolution.increment.x) * width) + 1;
+        haloY = ceilf(maxOffset * fabsf(convolution.increment.y) * height) + 1;
+    }
+    
+    void CpuBackend::getHalo(const Pass& pass, unsigned width, unsigned height, unsigned& haloX, unsigned& haloY)
+    {
+        // one extra pixel wherever there's a bilinear sample
+        haloX = haloY = 0;
+        switch (pass.type)
+        {
+            case Pass::CONVOLUTION:
+                getHalo(pass.convolution, width, height, haloX, haloY);
+                break;
+            case Pass::PIXELATE:
+                haloX = ceilf(width / max(pass.pixelate.resolution.x, 1.f)) + 1;
+                haloY = ceilf(height / max(pass.pixelate.resolution.y, 1.f)) + 1;
+                break;
+            case Pass::RGB_SHIFT:
+                haloX = ceilf(fabsf(pass.rgbShift.amount * cosf(pass.rgbShift.angle)) * width) + 1;
+                haloY = ceilf(fabsf(pass.rgbShift.amount * sinf(pass.rgbShift.angle)) * height) + 1;
+                break;
+            case Pass::FXAA:
+                // half the longest search span plus the neighbours
+                haloX = haloY = 6;
+                break;
+            case Pass::EDGE:
+                haloX = haloY = 1;
+                break;
+            default:
+                break;
+        }
+    }
+    
+    void CpuBackend::process(const vector<RenderPass::Ptr>& passes, CpuImage& image)
+    {
+        vector<Pass> supported;
+        for (unsigned i = 0; i < passes.size(); ++i)
+        {
+            if (!passes[i]->getEnabled()) continue;
+            Pass pass;
+            if (getPass(*passes[i], pass)) supported.push_back(pass);
+            else ofLogWarning() << "Pass " << passes[i]->getName() << " does not have a cpu version.";
+        }
+        process(supported, image);
+    }
+    
+    bool CpuBackend::process(RenderPass& pass, const CpuImage& src, CpuImage& dst)
+    {
+        Pass cpuPass;
+        if (!getPass(pass, cpuPass)) return false;
+        process(cpuPass, src, dst);
+        return true;
+    }
+    
+    void CpuBackend::process(const vector<Pass>& passes, CpuImage& image)
+    {
+        if (tiled) processTiled(passes, image);
+        else
+        {
+            for (unsigned i = 0; i < passes.size(); ++i)
+            {
+                process(passes[i], image, scratch);
+                swap(image, scratch);
+            }
+        }
+    }
+    
+    void CpuBackend::processTiled(const vector<Pass>& passes, CpuImage& image)
+    {
+        const unsigned w = image.getWidth();
+        const unsigned h = image.getHeight();
+        if (passes.empty() || w == 0 || h == 0) return;
+        
+        // the kernels point into the chain so it has to stay put until the run is done
+        chain = passes;
+        
+        // runs of passes that only read their own pixel are fused into one
+        // stage so each tile goes through all of them while it's in cache
+        vector<vector<const Pass*> > groups;
+        bool lastPointwise = false;
+        unsigned numImages = 0;
+        for (unsigned i = 0; i < chain.size(); ++i)
+        {
+            unsigned haloX, haloY;
+            getHalo(chain[i], w, h, haloX, haloY);
+            bool bloom = chain[i].type == Pass::BLOOM;
+            bool pointwise = !bloom && haloX == 0 && haloY == 0;
+            if (pointwise && lastPointwise) groups.back().push_back(&chain[i]);
+            else
+            {
+                groups.push_back(vector<const Pass*>(1, &chain[i]));
+                numImages += bloom ? 3 : 1;
+            }
+            lastPointwise = pointwise;
+        }
+        
+        if (stageImages.size() != numImages) stageImages.resize(numImages);
+        for (unsigned i = 0; i < stageImages.size(); ++i)
+        {
+            if (stageImages[i].getWidth() != w || stageImages[i].getHeight() != h) stageImages[i].allocate(w, h);
+        }
+        
+        scheduler.clear();
+        int input = TileScheduler::SOURCE;
+        const CpuImage* inputImage = &image;
+        unsigned nextImage = 0;
+        for (unsigned i = 0; i < groups.size(); ++i)
+        {
+            CpuImage* output = &stageImages[nextImage++];
+            unsigned haloX, haloY;
+            if (groups[i][0]->type == Pass::BLOOM)
+            {
+                const BloomParameters* bloom = &groups[i][0]->bloom;
+                CpuImage* xImage = output;
+                CpuImage* yImage = &stageImages[nextImage++];
+                output = &stageImages[nextImage++];
+                
+                getHalo(bloom->x, w, h, haloX, haloY);
+                int xStage = scheduler.addStage([=](const TileScheduler::Tile& tile) { convolve(*inputImage, *xImage, bloom->x, tile); },
+                                                vector<TileScheduler::Input>(1, TileScheduler::Input(input, haloX, haloY)));
+                getHalo(bloom->y, w, h, haloX, haloY);
+                int yStage = scheduler.addStage([=](const TileScheduler::Tile& tile) { convolve(*xImage, *yImage, bloom->y, tile); },
+                                                vector<TileScheduler::Input>(1, TileScheduler::Input(xStage, haloX, haloY)));
+                vector<TileScheduler::Input> inputs;
+                inputs.push_back(TileScheduler::Input(input));
+                inputs.push_back(TileScheduler::Input(yStage));
+                input = scheduler.addStage([=](const TileScheduler::Tile& tile) { bloomComposite(*inputImage, *yImage, *output, bloom->intensity, tile); }, inputs);
+            }
+            else
+            {
+                vector<Kernel> kernels;
+                for (unsigned j = 0; j < groups[i].size(); ++j) kernels.push_back(getKernel(*groups[i][j]));
+                getHalo(*groups[i][0], w, h, haloX, haloY);
+                // after the first pass the rest of the group runs in place
+                input = scheduler.addStage([=](const TileScheduler::Tile& tile)
+                                           {
+                                               kernels[0](*inputImage, *output, tile);
+                                               for (unsigned k = 1; k < kernels.size(); ++k) kernels[k](*output, *output, tile);
+                                           },
+                                           vector<TileScheduler::Input>(1, TileScheduler::Input(input, haloX, haloY)));
+            }
+            inputImage = output;
+        }
+        scheduler.run(w, h);
+        swap(image, stageImages.back());
+    }
+    
+    void CpuBackend::process(const Pass& pass, const CpuImage& src, CpuImage& dst)
+    {
+        const unsigned w = src.getWidth();
+        const unsigned h = src.getHeight();
+        if (dst.getWidth() != w || dst.getHeight() != h) dst.allocate(w, h);
+        
+        if (pass.type == Pass::BLOOM)
+        {
+            // the blurs run at full resolution rather than on the pass's smaller buffer
+            for (unsigned i = 0; i < 2; ++i)
+            {
+                if (bloomScratch[i].getWidth() != w || bloomScratch[i].getHeight() != h) bloomScratch[i].allocate(w, h);
+            }
+            const BloomParameters& bloom = pass.bloom;
+            parallelTiles(w, h, [&](const TileScheduler::Tile& tile) { convolve(src, bloomScratch[0], bloom.x, tile); });
+            parallelTiles(w, h, [&](const TileScheduler::Tile& tile) { convolve(bloomScratch[0], bloomScratch[1], bloom.y, tile); });
+            parallelTiles(w, h, [&](const TileScheduler::Tile& tile) { bloomComposite(src, bloomScratch[1], dst, bloom.intensity, tile); });
+            return;
+        }
+        
+        Kernel kernel = getKernel(pass);
+        parallelTiles(w, h, [&](const TileScheduler::Tile& tile) { kernel(src, dst, tile); });
+    }
+}
@@ -0,0 +1,220 @@
+/*
+ *  CpuBackend.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "RenderPass.h"
+#include "CpuImage.h"
+#include "TileScheduler.h"
+
+namespace itg
+{
+    /*
+     * Runs passes on the cpu, for machines without a gpu and as a reference
+     * for the shaders. A chain is a list of Pass values holding only plain
+     * parameters, so it can be built and run without a gl context. For
+     * chains that also run on the gpu getPass() copies the parameters of a
+     * pass object. Supported passes are ConvolutionPass, BloomPass
+     * (gaussian mode, without selective glow), ContrastPass, HsbShiftPass,
+     * BleachBypassPass, LUTPass, PixelatePass, RGBShiftPass, FxaaPass,
+     * EdgePass and LimbDarkeningPass. By default each pass is split into
+     * tiles run on the scheduler's workers. With setTiled(true) the whole
+     * chain goes to the scheduler at once instead, so there's no wait
+     * between passes and runs of passes that only read their own pixel are
+     * applied to a tile one after another.
+     */
+    class CpuBackend
+    {
+    public:
+        struct ConvolutionParameters
+        {
+            ConvolutionParameters() : threshold(0.f), knee(0.5f) {}
+            
+            // weights[0] is the centre tap, weights[i + 1] the pair at +-offsets[i]
+            vector<float> weights;
+            vector<float> offsets;
+            // texture coordinates between taps
+            ofVec2f increment;
+            // bright pass on each tap when above 0
+            float threshold, knee;
+        };
+        
+        struct BloomParameters
+        {
+            BloomParameters() : intensity(1.f) {}
+            
+            // the threshold of x is the bloom's
+            ConvolutionParameters x, y;
+            float intensity;
+        };
+        
+        struct ContrastParameters
+        {
+            ContrastParameters() : contrast(1.f), brightness(1.f), multiple(1.f) {}
+            
+            float contrast, brightness, multiple;
+        };
+        
+        struct HsbShiftParameters
+        {
+            HsbShiftParameters() : hueShift(0.f), saturationShift(0.f), brightnessShift(0.f) {}
+            
+            float hueShift, saturationShift, brightnessShift;
+        };
+        
+        struct BleachBypassParameters
+        {
+            BleachBypassParameters() : opacity(1.f) {}
+            
+            float opacity;
+        };
+        
+        struct LUTParameters
+        {
+            LUTParameters() : size(0), domainMax(1.f, 1.f, 1.f) {}
+            
+            // size^3 rgb entries with red changing fastest, empty copies the image
+            vector<float> data;
+            int size;
+            ofVec3f domainMin, domainMax;
+        };
+        
+        struct PixelateParameters
+        {
+            PixelateParameters() : resolution(100.f, 100.f) {}
+            
+            ofVec2f resolution;
+        };
+        
+        struct RGBShiftParameters
+        {
+            RGBShiftParameters() : amount(0.005f), angle(0.f) {}
+            
+            float amount, angle;
+        };
+        
+        // the defaults are FxaaPass::QUALITY_HIGH
+        struct FxaaParameters
+        {
+            FxaaParameters() : spanMax(8.f), reduceMul(1.f / 8.f), edgeThreshold(0.f), edgeThresholdMin(0.f), twoTap(false) {}
+            
+            float spanMax, reduceMul, edgeThreshold, edgeThresholdMin;
+            bool twoTap;
+        };
+        
+        struct EdgeParameters
+        {
+            EdgeParameters() : hue(0.5f), saturation(0.f) {}
+            
+            float hue, saturation;
+        };
+        
+        // a pass of a cpu chain, only the parameters for its type are used
+        struct Pass
+        {
+            enum Type
+            {
+                CONVOLUTION,
+                BLOOM,
+                CONTRAST,
+                HSB_SHIFT,
+                BLEACH_BYPASS,
+                LUT,
+                PIXELATE,
+                RGB_SHIFT,
+                FXAA,
+                EDGE,
+                LIMB_DARKENING
+            };
+            
+            Pass(Type type = CONVOLUTION) : type(type) {}
+            
+            Type type;
+            ConvolutionParameters convolution;
+            BloomParameters bloom;
+            ContrastParameters contrast;
+            HsbShiftParameters hsbShift;
+            BleachBypassParameters bleachBypass;
+            LUTParameters lut;
+            PixelateParameters pixelate;
+            RGBShiftParameters rgbShift;
+            FxaaParameters fxaa;
+            EdgeParameters edge;
+        };
+        
+        // 0 uses a thread for each core
+        CpuBackend(unsigned numThreads = 0);
+        
+        void process(const vector<Pass>& passes, CpuImage& image);
+        void process(const Pass& pass, const CpuImage& src, CpuImage& dst);
+        
+        // copies the parameters of pass, returns false if it doesn't have a cpu version
+        static bool getPass(RenderPass& pass, Pass& out);
+        static bool isSupported(RenderPass& pass);
+        
+        // runs the enabled passes in order, ones without a cpu version are skipped with a warning
+        void process(const vector<RenderPass::Ptr>& passes, CpuImage& image);
+        
+        // returns false if the pass doesn't have a cpu version
+        bool process(RenderPass& pass, const CpuImage& src, CpuImage& dst);
+        
+        unsigned getNumThreads() const { return numThreads; }
+        void setNumThreads(unsigned numThreads);
+        
+        bool getTiled() const { return tiled; }
+        void setTiled(bool tiled) { this->tiled = tiled; }
+        
+        TileScheduler& getSchedulerRef() { return scheduler; }
+        
+    private:
+        typedef function<void(const CpuImage&, CpuImage&, const TileScheduler::Tile&)> Kernel;
+        
+        // empty for bloom, which is made of several kernels, the pass has to outlive it
+        static Kernel getKernel(const Pass& pass);
+        
+        // how many pixels around the one being written the pass reads
+        static void getHalo(const Pass& pass, unsigned width, unsigned height, unsigned& haloX, unsigned& haloY);
+        static void getHalo(const ConvolutionParameters& convolution, unsigned width, unsigned height, unsigned& haloX, unsigned& haloY);
+        
+        void processTiled(const vector<Pass>& passes, CpuImage& image);
+        
+        // calls fn with each tile on the scheduler's workers
+        void parallelTiles(unsigned width, unsigned height, const TileScheduler::Kernel& fn);
+        
+        TileScheduler scheduler;
+        vector<Pass> chain;
+        vector<CpuImage> stageImages;
+        CpuImage scratch;
+        CpuImage bloomScratch[2];
+        unsigned numThreads;
+        bool tiled;
+    };
+}
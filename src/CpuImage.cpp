@@ -0,0 +1,121 @@
+/*
+ *  CpuImage.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "CpuImage.h"
+#include <algorithm>
+
+namespace itg
+{
+    CpuImage::CpuImage() : width(0), height(0)
+    {
+    }
+    
+    CpuImage::CpuImage(unsigned width, unsigned height) : width(0), height(0)
+    {
+        allocate(width, height);
+    }
+    
+    void CpuImage::allocate(unsigned width, unsigned height)
+    {
+        this->width = width;
+        this->height = height;
+        data.assign(4 * width * height, 0.f);
+    }
+    
+    void CpuImage::setFromPixels(const unsigned char* pixels, unsigned width, unsigned height, unsigned channels)
+    {
+        allocate(width, height);
+        for (unsigned i = 0; i < width * height; ++i)
+        {
+            const unsigned char* p = pixels + i * channels;
+            float* d = &data[4 * i];
+            if (channels < 3) d[0] = d[1] = d[2] = p[0] / 255.f;
+            else for (unsigned c = 0; c < 3; ++c) d[c] = p[c] / 255.f;
+            d[3] = channels == 4 ? p[3] / 255.f : 1.f;
+        }
+    }
+    
+    void CpuImage::setFromPixels(const float* pixels, unsigned width, unsigned height, unsigned channels)
+    {
+        allocate(width, height);
+        for (unsigned i = 0; i < width * height; ++i)
+        {
+            const float* p = pixels + i * channels;
+            float* d = &data[4 * i];
+            if (channels < 3) d[0] = d[1] = d[2] = p[0];
+            else for (unsigned c = 0; c < 3; ++c) d[c] = p[c];
+            d[3] = channels == 4 ? p[3] : 1.f;
+        }
+    }
+    
+    void CpuImage::getPixels(unsigned char* pixels, unsigned channels) const
+    {
+        for (unsigned i = 0; i < width * height; ++i)
+        {
+            for (unsigned c = 0; c < channels; ++c)
+            {
+                // single channel output is the red channel
+                float v = data[4 * i + c];
+                pixels[i * channels + c] = v <= 0.f ? 0 : v >= 1.f ? 255 : (unsigned char)(v * 255.f + 0.5f);
+            }
+        }
+    }
+    
+    void CpuImage::getPixels(float* pixels, unsigned channels) const
+    {
+        for (unsigned i = 0; i < width * height; ++i)
+        {
+            for (unsigned c = 0; c < channels; ++c) pixels[i * channels + c] = data[4 * i + c];
+        }
+    }
+    
+    Float4 CpuImage::fetch(int x, int y) const
+    {
+        x = min(max(x, 0), (int)width - 1);
+        y = min(max(y, 0), (int)height - 1);
+        return Float4::load(&data[4 * (width * y + x)]);
+    }
+    
+    Float4 CpuImage::sample(float u, float v) const
+    {
+        float x = u * width - 0.5f;
+        float y = v * height - 0.5f;
+        float x0 = floorf(x);
+        float y0 = floorf(y);
+        float fx = x - x0;
+        float fy = y - y0;
+        int ix = x0;
+        int iy = y0;
+        Float4 bottom = mix(fetch(ix, iy), fetch(ix + 1, iy), fx);
+        Float4 top = mix(fetch(ix, iy + 1), fetch(ix + 1, iy + 1), fx);
+        return mix(bottom, top, fy);
+    }
+}
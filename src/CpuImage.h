@@ -0,0 +1,78 @@
+/*
+ *  CpuImage.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "CpuSimd.h"
+#include <vector>
+
+namespace itg
+{
+    using namespace std;
+    
+    /*
+     * Float rgba image for the cpu backend. Rows go from the bottom up like
+     * gl textures so texture coordinates match the shaders.
+     */
+    class CpuImage
+    {
+    public:
+        CpuImage();
+        CpuImage(unsigned width, unsigned height);
+        
+        void allocate(unsigned width, unsigned height);
+        bool isAllocated() const { return !data.empty(); }
+        
+        // 8 bit or float pixels with 1, 3 or 4 channels, 8 bit values are mapped to 0-1
+        void setFromPixels(const unsigned char* pixels, unsigned width, unsigned height, unsigned channels);
+        void setFromPixels(const float* pixels, unsigned width, unsigned height, unsigned channels);
+        void getPixels(unsigned char* pixels, unsigned channels) const;
+        void getPixels(float* pixels, unsigned channels) const;
+        
+        unsigned getWidth() const { return width; }
+        unsigned getHeight() const { return height; }
+        
+        float* getData() { return &data[0]; }
+        const float* getData() const { return &data[0]; }
+        float* getRow(unsigned y) { return &data[4 * width * y]; }
+        const float* getRow(unsigned y) const { return &data[4 * width * y]; }
+        
+        // clamped to the edge like the ping pong textures
+        Float4 fetch(int x, int y) const;
+        
+        // bilinear, u and v are texture coordinates from 0 to 1
+        Float4 sample(float u, float v) const;
+        
+    private:
+        vector<float> data;
+        unsigned width, height;
+    };
+}
@@ -0,0 +1,104 @@
+/*
+ *  CpuSimd.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define ITG_SIMD_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define ITG_SIMD_NEON
+#endif
+
+#include <cmath>
+
+namespace itg
+{
+    /*
+     * Four floats operated on together, used by the cpu backend for one rgba
+     * pixel at a time. SSE on x86, NEON on ARM and plain floats elsewhere.
+     */
+    struct Float4
+    {
+#if defined(ITG_SIMD_SSE)
+        __m128 v;
+        Float4() : v(_mm_setzero_ps()) {}
+        Float4(__m128 v) : v(v) {}
+        explicit Float4(float s) : v(_mm_set1_ps(s)) {}
+        Float4(float x, float y, float z, float w) : v(_mm_setr_ps(x, y, z, w)) {}
+        static Float4 load(const float* p) { return Float4(_mm_loadu_ps(p)); }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+        Float4 operator+(const Float4& o) const { return Float4(_mm_add_ps(v, o.v)); }
+        Float4 operator-(const Float4& o) const { return Float4(_mm_sub_ps(v, o.v)); }
+        Float4 operator*(const Float4& o) const { return Float4(_mm_mul_ps(v, o.v)); }
+        Float4 operator*(float s) const { return Float4(_mm_mul_ps(v, _mm_set1_ps(s))); }
+        friend Float4 min(const Float4& a, const Float4& b) { return Float4(_mm_min_ps(a.v, b.v)); }
+        friend Float4 max(const Float4& a, const Float4& b) { return Float4(_mm_max_ps(a.v, b.v)); }
+#elif defined(ITG_SIMD_NEON)
+        float32x4_t v;
+        Float4() : v(vdupq_n_f32(0.f)) {}
+        Float4(float32x4_t v) : v(v) {}
+        explicit Float4(float s) : v(vdupq_n_f32(s)) {}
+        Float4(float x, float y, float z, float w) { float f[4] = { x, y, z, w }; v = vld1q_f32(f); }
+        static Float4 load(const float* p) { return Float4(vld1q_f32(p)); }
+        void store(float* p) const { vst1q_f32(p, v); }
+        Float4 operator+(const Float4& o) const { return Float4(vaddq_f32(v, o.v)); }
+        Float4 operator-(const Float4& o) const { return Float4(vsubq_f32(v, o.v)); }
+        Float4 operator*(const Float4& o) const { return Float4(vmulq_f32(v, o.v)); }
+        Float4 operator*(float s) const { return Float4(vmulq_n_f32(v, s)); }
+        friend Float4 min(const Float4& a, const Float4& b) { return Float4(vminq_f32(a.v, b.v)); }
+        friend Float4 max(const Float4& a, const Float4& b) { return Float4(vmaxq_f32(a.v, b.v)); }
+#else
+        float f[4];
+        Float4() { f[0] = f[1] = f[2] = f[3] = 0.f; }
+        explicit Float4(float s) { f[0] = f[1] = f[2] = f[3] = s; }
+        Float4(float x, float y, float z, float w) { f[0] = x; f[1] = y; f[2] = z; f[3] = w; }
+        static Float4 load(const float* p) { return Float4(p[0], p[1], p[2], p[3]); }
+        void store(float* p) const { for (int i = 0; i < 4; ++i) p[i] = f[i]; }
+        Float4 operator+(const Float4& o) const { return Float4(f[0] + o.f[0], f[1] + o.f[1], f[2] + o.f[2], f[3] + o.f[3]); }
+        Float4 operator-(const Float4& o) const { return Float4(f[0] - o.f[0], f[1] - o.f[1], f[2] - o.f[2], f[3] - o.f[3]); }
+        Float4 operator*(const Float4& o) const { return Float4(f[0] * o.f[0], f[1] * o.f[1], f[2] * o.f[2], f[3] * o.f[3]); }
+        Float4 operator*(float s) const { return Float4(f[0] * s, f[1] * s, f[2] * s, f[3] * s); }
+        friend Float4 min(const Float4& a, const Float4& b) { return Float4(fminf(a.f[0], b.f[0]), fminf(a.f[1], b.f[1]), fminf(a.f[2], b.f[2]), fminf(a.f[3], b.f[3])); }
+        friend Float4 max(const Float4& a, const Float4& b) { return Float4(fmaxf(a.f[0], b.f[0]), fmaxf(a.f[1], b.f[1]), fmaxf(a.f[2], b.f[2]), fmaxf(a.f[3], b.f[3])); }
+#endif
+        Float4& operator+=(const Float4& o) { *this = *this + o; return *this; }
+        Float4& operator*=(const Float4& o) { *this = *this * o; return *this; }
+        Float4& operator*=(float s) { *this = *this * s; return *this; }
+        
+        float operator[](int i) const { float f[4]; store(f); return f[i]; }
+        
+        friend Float4 clamp(const Float4& a, float lo, float hi) { return min(max(a, Float4(lo)), Float4(hi)); }
+        friend Float4 mix(const Float4& a, const Float4& b, float t) { return a + (b - a) * t; }
+        friend float dot3(const Float4& a, float r, float g, float b) { float f[4]; a.store(f); return f[0] * r + f[1] * g + f[2] * b; }
+    };
+}
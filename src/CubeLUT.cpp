@@ -0,0 +1,562 @@
+/*
+ *  CubeLUT.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "CubeLUT.h"
+
+#ifdef TARGET_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace itg
+{
+    namespace
+    {
+        string cacheDirectory;
+        bool cacheDirectorySet = false;
+        
+        const char CACHE_MAGIC[4] = { 'I', 'L', 'U', 'T' };
+        const uint32_t CACHE_VERSION = 2;
+        
+        struct CacheHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint64_t hash;
+            // of the .cube file, checked along with the hash
+            uint64_t sourceLength;
+            int32_t size;
+            uint32_t was1D;
+            float domainMin[3];
+            float domainMax[3];
+            uint32_t titleLength;
+        };
+        
+        // read only view of a whole file
+        class MappedFile
+        {
+        public:
+            MappedFile(const string& path) : bytes(NULL), length(0)
+            {
+#ifdef TARGET_WIN32
+                mapping = NULL;
+                file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+                if (file == INVALID_HANDLE_VALUE) return;
+                LARGE_INTEGER fileSize;
+                if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+                mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                if (!mapping) return;
+                bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (bytes) length = fileSize.QuadPart;
+#else
+                fd = open(path.c_str(), O_RDONLY);
+                if (fd < 0) return;
+                struct stat info;
+                if (fstat(fd, &info) != 0 || info.st_size == 0) return;
+                void* address = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address == MAP_FAILED) return;
+                madvise(address, info.st_size, MADV_SEQUENTIAL);
+                bytes = (const char*)address;
+                length = info.st_size;
+#endif
+            }
+            
+            ~MappedFile()
+            {
+#ifdef TARGET_WIN32
+                if (bytes) UnmapViewOfFile(bytes);
+                if (mapping) CloseHandle(mapping);
+                if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+                if (bytes) munmap((void*)bytes, length);
+                if (fd >= 0) close(fd);
+#endif
+            }
+            
+            const char* getBytes() const { return bytes; }
+            size_t getLength() const { return length; }
+            
+        private:
+            MappedFile(const MappedFile&);
+            MappedFile& operator=(const MappedFile&);
+            
+            const char* bytes;
+            size_t length;
+#ifdef TARGET_WIN32
+            HANDLE file;
+            HANDLE mapping;
+#else
+            int fd;
+#endif
+        };
+        
+        bool isDigit(char c)
+        {
+            return c >= '0' && c <= '9';
+        }
+        
+        bool isSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+        
+        const char* skipSpaces(const char* p, const char* end)
+        {
+            while (p < end && isSpace(*p)) ++p;
+            return p;
+        }
+        
+        const char* skipLine(const char* p, const char* end)
+        {
+            while (p < end && *p != '\n') ++p;
+            return p < end ? p + 1 : end;
+        }
+        
+        // parses a decimal number like strtof but without locale lookups or
+        // errno, returns NULL if there isn't a number at p
+        const char* parseFloat(const char* p, const char* end, float& value)
+        {
+            static const double POWERS[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+            
+            bool negative = false;
+            if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+            
+            // up to 19 significant digits fit in the mantissa, the rest only move the exponent
+            uint64_t mantissa = 0;
+            int numDigits = 0;
+            int exponent = 0;
+            bool any = false;
+            for (; p < end && isDigit(*p); ++p, any = true)
+            {
+                if (numDigits < 19)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa) ++numDigits;
+                }
+                else ++exponent;
+            }
+            if (p < end && *p == '.')
+            {
+                for (++p; p < end && isDigit(*p); ++p, any = true)
+                {
+                    if (numDigits < 19)
+                    {
+                        mantissa = mantissa * 10 + (*p - '0');
+                        if (mantissa) ++numDigits;
+                        --exponent;
+                    }
+                }
+            }
+            if (!any) return NULL;
+            
+            if (p < end && (*p == 'e' || *p == 'E'))
+            {
+                const char* q = p + 1;
+                bool negativeExponent = false;
+                if (q < end && (*q == '-' || *q == '+')) negativeExponent = *q++ == '-';
+                if (q < end && isDigit(*q))
+                {
+                    int e = 0;
+                    for (; q < end && isDigit(*q); ++q) e = min(e * 10 + (*q - '0'), 10000);
+                    exponent += negativeExponent ? -e : e;
+                    p = q;
+                }
+            }
+            
+            double result = mantissa;
+            if (exponent < 0) result /= -exponent <= 22 ? POWERS[-exponent] : pow(10.0, -exponent);
+            else if (exponent > 0) result *= exponent <= 22 ? POWERS[exponent] : pow(10.0, exponent);
+            value = negative ? -result : result;
+            return p;
+        }
+        
+        // parses count numbers separated by spaces, returns NULL if there aren't enough
+        const char* parseFloats(const char* p, const char* end, float* values, unsigned count)
+        {
+            for (unsigned i = 0; i < count; ++i)
+            {
+                p = skipSpaces(p, end);
+                p = parseFloat(p, end, values[i]);
+                if (!p) return NULL;
+            }
+            return p;
+        }
+        
+        const char* parseInt(const char* p, const char* end, int& value)
+        {
+            p = skipSpaces(p, end);
+            if (p == end || !isDigit(*p)) return NULL;
+            value = 0;
+            for (; p < end && isDigit(*p); ++p) value = min(value * 10 + (*p - '0'), 1 << 20);
+            return p;
+        }
+        
+        bool startsWith(const char* p, const char* end, const char* keyword, size_t keywordLength)
+        {
+            if ((size_t)(end - p) < keywordLength || memcmp(p, keyword, keywordLength) != 0) return false;
+            // the keyword has to be followed by a space or the end of the line
+            return p + keywordLength == end || isSpace(p[keywordLength]) || p[keywordLength] == '\n';
+        }
+        
+        // linearly interpolates one channel of a 1D table at t in [0, 1]
+        float sample1D(const vector<float>& table, int size, int channel, float t)
+        {
+            float x = ofClamp(t, 0.f, 1.f) * (size - 1);
+            int i = min((int)x, size - 2);
+            float f = x - i;
+            return table[3 * i + channel] * (1.f - f) + table[3 * (i + 1) + channel] * f;
+        }
+    }
+    
+    CubeLUT::CubeLUT() : domainMin(0.f, 0.f, 0.f), domainMax(1.f, 1.f, 1.f), size(0), was1D(false)
+    {
+    }
+    
+    void CubeLUT::clear()
+    {
+        title.clear();
+        data.clear();
+        domainMin.set(0.f, 0.f, 0.f);
+        domainMax.set(1.f, 1.f, 1.f);
+        size = 0;
+        was1D = false;
+    }
+    
+    void CubeLUT::setCacheDirectory(const string& cacheDirectory)
+    {
+        itg::cacheDirectory = cacheDirectory;
+        cacheDirectorySet = true;
+    }
+    
+    string CubeLUT::getCacheDirectory()
+    {
+        return cacheDirectorySet ? cacheDirectory : ofToDataPath("lut_cache", true);
+    }
+    
+    uint64_t CubeLUT::hash(const char* bytes, size_t length)
+    {
+        // xxhash64's round and finaliser over eight bytes per step, so hashing
+        // stays well below the cost of parsing. The multiply, rotate and
+        // multiply carry every bit of a word into the whole state, xoring
+        // words straight into an fnv state only spread them upwards and let
+        // changes in different words cancel.
+        const uint64_t PRIME1 = 11400714785074694791ULL;
+        const uint64_t PRIME2 = 14029467366897019727ULL;
+        const uint64_t PRIME3 = 1609587929392839161ULL;
+        uint64_t h = PRIME3 + length;
+        size_t i = 0;
+        for (; i + 8 <= length; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i, 8);
+            h += word * PRIME2;
+            h = (h << 31) | (h >> 33);
+            h *= PRIME1;
+        }
+        for (; i < length; ++i)
+        {
+            h ^= (unsigned char)bytes[i] * PRIME1;
+            h = (h << 11) | (h >> 53);
+            h *= PRIME2;
+        }
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+        return h;
+    }
+    
+    bool CubeLUT::load(const string& path, bool useCache)
+    {
+        clear();
+        
+        MappedFile file(ofToDataPath(path));
+        if (!file.getBytes())
+        {
+            ofLogError() << "Could not open LUT " << path;
+            return false;
+        }
+        
+        string cachePath;
+        uint64_t fileHash = 0;
+        string directory = useCache ? getCacheDirectory() : "";
+        if (!directory.empty())
+        {
+            fileHash = hash(file.getBytes(), file.getLength());
+            char name[32];
+            sprintf(name, "%016llx.lut", (unsigned long long)fileHash);
+            cachePath = directory + "/" + name;
+            if (loadCache(cachePath, fileHash, file.getLength())) return true;
+        }
+        
+        if (!parse(file.getBytes(), file.getLength()))
+        {
+            ofLogError() << "Could not parse LUT " << path;
+            return false;
+        }
+        
+        if (!cachePath.empty())
+        {
+            ofDirectory::createDirectory(directory, false, true);
+            saveCache(cachePath, fileHash, file.getLength());
+        }
+        return true;
+    }
+    
+    bool CubeLUT::parse(const char* text, size_t length)
+    {
+        clear();
+        
+        const char* p = text;
+        const char* end = text + length;
+        int size1D = 0;
+        int size3D = 0;
+        unsigned expected = 0;
+        vector<float> table;
+        unsigned lineNumber = 0;
+        
+        while (p < end)
+        {
+            ++lineNumber;
+            p = skipSpaces(p, end);
+            if (p == end) break;
+            
+            const char c = *p;
+            if (c == '\n')
+            {
+                ++p;
+                continue;
+            }
+            if (c == '#')
+            {
+                p = skipLine(p, end);
+                continue;
+            }
+            
+            if (isDigit(c) || c == '-' || c == '+' || c == '.')
+            {
+                if (expected == 0)
+                {
+                    ofLogError() << "LUT data before LUT_1D_SIZE or LUT_3D_SIZE on line " << lineNumber;
+                    return false;
+                }
+                if (table.size() == 3 * expected)
+                {
+                    ofLogError() << "LUT has more than " << expected << " entries";
+                    return false;
+                }
+                float rgb[3];
+                const char* next = parseFloats(p, end, rgb, 3);
+                if (!next)
+                {
+                    ofLogError() << "Could not read LUT entry on line " << lineNumber;
+                    return false;
+                }
+                table.insert(table.end(), rgb, rgb + 3);
+                p = skipLine(next, end);
+                continue;
+            }
+            
+            const char* lineEnd = p;
+            while (lineEnd < end && *lineEnd != '\n') ++lineEnd;
+            
+            float values[3];
+            if (startsWith(p, lineEnd, "TITLE", 5))
+            {
+                const char* open = (const char*)memchr(p, '"', lineEnd - p);
+                const char* close = open ? (const char*)memchr(open + 1, '"', lineEnd - open - 1) : NULL;
+                if (open && close) title.assign(open + 1, close);
+            }
+            else if (startsWith(p, lineEnd, "LUT_3D_SIZE", 11))
+            {
+                if (!parseInt(p + 11, lineEnd, size3D) || size3D < 2 || size3D > 256)
+                {
+                    ofLogError() << "Invalid LUT_3D_SIZE on line " << lineNumber;
+                    return false;
+                }
+                expected = size3D * size3D * size3D;
+            }
+            else if (startsWith(p, lineEnd, "LUT_1D_SIZE", 11))
+            {
+                if (!parseInt(p + 11, lineEnd, size1D) || size1D < 2 || size1D > 65536)
+                {
+                    ofLogError() << "Invalid LUT_1D_SIZE on line " << lineNumber;
+                    return false;
+                }
+                expected = size1D;
+            }
+            else if (startsWith(p, lineEnd, "DOMAIN_MIN", 10))
+            {
+                if (!parseFloats(p + 10, lineEnd, values, 3)) ofLogWarning() << "Invalid DOMAIN_MIN on line " << lineNumber;
+                else domainMin.set(values[0], values[1], values[2]);
+            }
+            else if (startsWith(p, lineEnd, "DOMAIN_MAX", 10))
+            {
+                if (!parseFloats(p + 10, lineEnd, values, 3)) ofLogWarning() << "Invalid DOMAIN_MAX on line " << lineNumber;
+                else domainMax.set(values[0], values[1], values[2]);
+            }
+            else if (startsWith(p, lineEnd, "LUT_1D_INPUT_RANGE", 18) || startsWith(p, lineEnd, "LUT_3D_INPUT_RANGE", 18))
+            {
+                if (!parseFloats(p + 18, lineEnd, values, 2)) ofLogWarning() << "Invalid input range on line " << lineNumber;
+                else
+                {
+                    domainMin.set(values[0], values[0], values[0]);
+                    domainMax.set(values[1], values[1], values[1]);
+                }
+            }
+            else ofLogVerbose() << "Ignoring unknown LUT keyword on line " << lineNumber;
+            
+            p = skipLine(lineEnd, end);
+            
+            // the size comes before the data so the table only needs allocating once
+            if (expected && table.capacity() < 3 * expected) table.reserve(3 * expected);
+        }
+        
+        if (size1D && size3D)
+        {
+            ofLogError() << "LUT has both LUT_1D_SIZE and LUT_3D_SIZE";
+            return false;
+        }
+        if (expected == 0 || table.size() != 3 * expected)
+        {
+            ofLogError() << "LUT size is incorrect.";
+            return false;
+        }
+        if (domainMax.x <= domainMin.x || domainMax.y <= domainMin.y || domainMax.z <= domainMin.z)
+        {
+            ofLogError() << "LUT domain is empty.";
+            return false;
+        }
+        
+        if (size3D)
+        {
+            size = size3D;
+            data.swap(table);
+        }
+        else
+        {
+            // the channels of a 1D LUT are independent so trilinear filtering of
+            // the expanded table is the same as linear filtering of each
+            // channel, apart from resampling it when there are more entries
+            // than MAX_EXPANDED_SIZE
+            size = min(size1D, (int)MAX_EXPANDED_SIZE);
+            was1D = true;
+            vector<float> r(size), g(size), b(size);
+            for (int i = 0; i < size; ++i)
+            {
+                float t = i / (size - 1.f);
+                r[i] = sample1D(table, size1D, 0, t);
+                g[i] = sample1D(table, size1D, 1, t);
+                b[i] = sample1D(table, size1D, 2, t);
+            }
+            data.resize(3 * size * size * size);
+            float* out = &data[0];
+            for (int z = 0; z < size; ++z)
+            {
+                for (int y = 0; y < size; ++y)
+                {
+                    for (int x = 0; x < size; ++x)
+                    {
+                        *out++ = r[x];
+                        *out++ = g[y];
+                        *out++ = b[z];
+                    }
+                }
+            }
+        }
+        return true;
+    }
+    
+    bool CubeLUT::loadCache(const string& cachePath, uint64_t fileHash, uint64_t sourceLength)
+    {
+        MappedFile file(cachePath);
+        if (!file.getBytes() || file.getLength() < sizeof(CacheHeader)) return false;
+        
+        CacheHeader header;
+        memcpy(&header, file.getBytes(), sizeof(header));
+        if (memcmp(header.magic, CACHE_MAGIC, 4) != 0 || header.version != CACHE_VERSION || header.hash != fileHash) return false;
+        if (header.sourceLength != sourceLength) return false;
+        if (header.size < 2 || header.size > 256) return false;
+        
+        size_t numFloats = 3 * (size_t)header.size * header.size * header.size;
+        if (file.getLength() != sizeof(header) + header.titleLength + numFloats * sizeof(float)) return false;
+        
+        const char* p = file.getBytes() + sizeof(header);
+        title.assign(p, header.titleLength);
+        data.resize(numFloats);
+        memcpy(&data[0], p + header.titleLength, numFloats * sizeof(float));
+        domainMin.set(header.domainMin[0], header.domainMin[1], header.domainMin[2]);
+        domainMax.set(header.domainMax[0], header.domainMax[1], header.domainMax[2]);
+        was1D = header.was1D != 0;
+        size = header.size;
+        return true;
+    }
+    
+    void CubeLUT::saveCache(const string& cachePath, uint64_t fileHash, uint64_t sourceLength) const
+    {
+        CacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CACHE_MAGIC, 4);
+        header.version = CACHE_VERSION;
+        header.hash = fileHash;
+        header.sourceLength = sourceLength;
+        header.size = size;
+        header.was1D = was1D ? 1 : 0;
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            header.domainMin[i] = domainMin[i];
+            header.domainMax[i] = domainMax[i];
+        }
+        header.titleLength = title.size();
+        
+        // written to a temporary file first so another process never sees half a cache
+        string tempPath = cachePath + ".tmp";
+        {
+            ofstream ofs(tempPath.c_str(), ios::binary);
+            ofs.write((const char*)&header, sizeof(header));
+            ofs.write(title.data(), title.size());
+            ofs.write((const char*)&data[0], data.size() * sizeof(float));
+            if (!ofs)
+            {
+                ofLogWarning() << "Could not write LUT cache " << cachePath;
+                return;
+            }
+        }
+        remove(cachePath.c_str());
+        if (rename(tempPath.c_str(), cachePath.c_str()) != 0) remove(tempPath.c_str());
+    }
+}
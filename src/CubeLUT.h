@@ -0,0 +1,96 @@
+/*
+ *  CubeLUT.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "ofMain.h"
+
+namespace itg
+{
+    /*
+     * Loads Adobe/Resolve .cube files: TITLE, DOMAIN_MIN, DOMAIN_MAX,
+     * LUT_1D_SIZE, LUT_3D_SIZE and the LUT_*_INPUT_RANGE variants. The file
+     * is memory mapped and parsed in place without sscanf. 1D LUTs are
+     * expanded to a 3D LUT so everything downstream only deals with one
+     * kind. After the first load the result is written to a binary cache
+     * named after a hash of the file's contents, so loading the same file
+     * again only hashes it and copies the cached table.
+     */
+    class CubeLUT
+    {
+    public:
+        CubeLUT();
+        
+        // path is relative to the data folder, returns false and logs an error if the file is invalid
+        bool load(const string& path, bool useCache = true);
+        
+        // parses the contents of a .cube file
+        bool parse(const char* text, size_t length);
+        
+        void clear();
+        
+        bool isLoaded() const { return size > 0; }
+        
+        const string& getTitle() const { return title; }
+        
+        // rgb entries with red changing fastest
+        const vector<float>& getData() const { return data; }
+        int getSize() const { return size; }
+        
+        // input values that map to the first and last entries of each axis
+        const ofVec3f& getDomainMin() const { return domainMin; }
+        const ofVec3f& getDomainMax() const { return domainMax; }
+        
+        // true if the file was a 1D LUT that's been expanded
+        bool getWas1D() const { return was1D; }
+        
+        // where cached tables are written, defaults to lut_cache in the data folder, empty disables the cache
+        static void setCacheDirectory(const string& cacheDirectory);
+        static string getCacheDirectory();
+        
+        // 64 bit hash, an xxhash64 style round per 8 byte word then its avalanche finaliser
+        static uint64_t hash(const char* bytes, size_t length);
+        
+        // largest 3D size a 1D LUT is expanded to
+        static const int MAX_EXPANDED_SIZE = 65;
+        
+    private:
+        bool loadCache(const string& cachePath, uint64_t fileHash, uint64_t sourceLength);
+        void saveCache(const string& cachePath, uint64_t fileHash, uint64_t sourceLength) const;
+        
+        string title;
+        vector<float> data;
+        ofVec3f domainMin;
+        ofVec3f domainMax;
+        int size;
+        bool was1D;
+    };
+}
@@ -0,0 +1,148 @@
+/*
+ *  DepthPyramid.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "DepthPyramid.h"
+
+namespace itg
+{
+    DepthPyramid::DepthPyramid() : cameraNear(1.f), cameraFar(1000.f), arb(false)
+    {
+    }
+    
+    void DepthPyramid::allocate(unsigned width, unsigned height, bool arb, unsigned numLevels)
+    {
+        this->arb = arb;
+        
+        levels.clear();
+        levels.resize(max(numLevels, 1u));
+        
+        ofFbo::Settings s;
+        s.textureTarget = GL_TEXTURE_2D;
+        s.internalformat = GL_RG32F;
+        s.minFilter = GL_NEAREST;
+        s.maxFilter = GL_NEAREST;
+        for (unsigned i = 0; i < levels.size(); ++i)
+        {
+            s.width = max(width >> i, 1u);
+            s.height = max(height >> i, 1u);
+            levels[i].allocate(s);
+        }
+        
+        string linearizeSrc = STRINGIFY(
+            uniform SAMPLER_TYPE depthTex;
+            uniform float cameraNear;
+            uniform float cameraFar;
+            
+            void main()
+            {
+                float z = TEXTURE_FN(depthTex, gl_TexCoord[0].st).x;
+                float linear = cameraNear * cameraFar / (cameraFar - z * (cameraFar - cameraNear));
+                gl_FragColor = vec4(linear, linear, 0.0, 1.0);
+            }
+        );
+        
+        ostringstream oss;
+        oss << "#version 120" << endl;
+        if (arb)
+        {
+            oss << "#define SAMPLER_TYPE sampler2DRect" << endl;
+            oss << "#define TEXTURE_FN texture2DRect" << endl;
+        }
+        else
+        {
+            oss << "#define SAMPLER_TYPE sampler2D" << endl;
+            oss << "#define TEXTURE_FN texture2D" << endl;
+        }
+        oss << linearizeSrc;
+        linearizeShader.setupShaderFromSource(GL_FRAGMENT_SHADER, oss.str());
+        linearizeShader.linkProgram();
+        
+        // each texel of the destination covers 2x2 texels of the source
+        string reduceSrc = STRINGIFY(
+            uniform sampler2D tex;
+            uniform vec2 texel;
+            
+            void main()
+            {
+                vec2 uv = gl_TexCoord[0].st;
+                vec2 a = texture2D(tex, uv + texel * vec2(-0.5, -0.5)).rg;
+                vec2 b = texture2D(tex, uv + texel * vec2( 0.5, -0.5)).rg;
+                vec2 c = texture2D(tex, uv + texel * vec2(-0.5,  0.5)).rg;
+                vec2 d = texture2D(tex, uv + texel * vec2( 0.5,  0.5)).rg;
+                float minDepth = min(min(a.r, b.r), min(c.r, d.r));
+                float maxDepth = max(max(a.g, b.g), max(c.g, d.g));
+                gl_FragColor = vec4(minDepth, maxDepth, 0.0, 1.0);
+            }
+        );
+        
+        if (levels.size() > 1)
+        {
+            reduceShader.setupShaderFromSource(GL_FRAGMENT_SHADER, "#version 120\n" + reduceSrc);
+            reduceShader.linkProgram();
+        }
+    }
+    
+    void DepthPyramid::update(ofTexture& depth, float cameraNear, float cameraFar)
+    {
+        this->cameraNear = cameraNear;
+        this->cameraFar = cameraFar;
+        
+        levels[0].begin();
+        linearizeShader.begin();
+        linearizeShader.setUniformTexture("depthTex", depth, 0);
+        linearizeShader.setUniform1f("cameraNear", cameraNear);
+        linearizeShader.setUniform1f("cameraFar", cameraFar);
+        glBegin(GL_QUADS);
+        glTexCoord2f(0, 0); glVertex2f(0, 0);
+        glTexCoord2f(arb ? depth.getWidth() : 1.f, 0); glVertex2f(levels[0].getWidth(), 0);
+        glTexCoord2f(arb ? depth.getWidth() : 1.f, arb ? depth.getHeight() : 1.f); glVertex2f(levels[0].getWidth(), levels[0].getHeight());
+        glTexCoord2f(0, arb ? depth.getHeight() : 1.f); glVertex2f(0, levels[0].getHeight());
+        glEnd();
+        linearizeShader.end();
+        levels[0].end();
+        
+        for (unsigned i = 1; i < levels.size(); ++i)
+        {
+            levels[i].begin();
+            reduceShader.begin();
+            reduceShader.setUniformTexture("tex", levels[i - 1].getTexture(), 0);
+            reduceShader.setUniform2f("texel", 1.f / levels[i - 1].getWidth(), 1.f / levels[i - 1].getHeight());
+            glBegin(GL_QUADS);
+            glTexCoord2f(0, 0); glVertex2f(0, 0);
+            glTexCoord2f(1, 0); glVertex2f(levels[i].getWidth(), 0);
+            glTexCoord2f(1, 1); glVertex2f(levels[i].getWidth(), levels[i].getHeight());
+            glTexCoord2f(0, 1); glVertex2f(0, levels[i].getHeight());
+            glEnd();
+            reduceShader.end();
+            levels[i].end();
+        }
+    }
+}
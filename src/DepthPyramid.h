@@ -0,0 +1,74 @@
+/*
+ *  DepthPyramid.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "RenderPass.h"
+
+namespace itg
+{
+    /*
+     * Eye space depth and a min/max (hi-z) chain built from it once a frame
+     * by PostProcessing when it has a camera, so passes don't each have to
+     * linearise the depth buffer. Level 0 is full resolution and each level
+     * after is half the size of the one before, r holds the minimum and g the
+     * maximum distance from the camera within a texel's footprint. SSAO and
+     * DofAlt only read level 0 so that's all that is built by default, pass a
+     * larger numLevels to allocate() to get the reduced levels as well.
+     */
+    class DepthPyramid
+    {
+    public:
+        static const unsigned DEFAULT_NUM_LEVELS = 1;
+        
+        DepthPyramid();
+        
+        void allocate(unsigned width, unsigned height, bool arb, unsigned numLevels = DEFAULT_NUM_LEVELS);
+        bool isAllocated() const { return !levels.empty(); }
+        
+        void update(ofTexture& depth, float cameraNear, float cameraFar);
+        
+        // levels are always GL_TEXTURE_2D so use normalised texture coordinates
+        ofTexture& getTexture(unsigned level = 0) { return levels[level].getTexture(); }
+        unsigned getNumLevels() const { return levels.size(); }
+        
+        float getCameraNear() const { return cameraNear; }
+        float getCameraFar() const { return cameraFar; }
+        
+    private:
+        vector<ofFbo> levels;
+        ofShader linearizeShader;
+        ofShader reduceShader;
+        float cameraNear;
+        float cameraFar;
+        bool arb;
+    };
+}
@@ -30,13 +30,35 @@
  *
  */
 #include "DofAltPass.h"
+#include "DepthPyramid.h"
+#include "NoiseTextures.h"
 
 namespace itg
 {
+    DofAltPass::Settings::Settings(int samples, int rings, bool autofocus, bool noise, bool depthBlur, bool manualDof) :
+        samples(samples), rings(rings), autofocus(autofocus), noise(noise), depthBlur(depthBlur), manualDof(manualDof)
+    {
+    }
+    
+    bool DofAltPass::Settings::operator<(const Settings& other) const
+    {
+        if (samples != other.samples) return samples < other.samples;
+        if (rings != other.rings) return rings < other.rings;
+        if (autofocus != other.autofocus) return autofocus < other.autofocus;
+        if (noise != other.noise) return noise < other.noise;
+        if (depthBlur != other.depthBlur) return depthBlur < other.depthBlur;
+        return manualDof < other.manualDof;
+    }
+    
     DofAltPass::DofAltPass(const ofVec2f& aspect, bool arb, float focalDepth, float focalLength, float fStop, bool showFocus) :
-        focalDepth(focalDepth), focalLength(focalLength), fStop(fStop), showFocus(showFocus), RenderPass(aspect, arb, "dofalt")
+        tileClassification(true), accumulate(false), blueNoise(false), RenderPass(aspect, arb, "dofalt")
     {
-        string fragShaderSrc = STRINGIFY(
+        Parameters p = { focalDepth, focalLength, fStop, showFocus };
+        parameters.write(p);
+        parameters.latch();
+        guiParameters = latchedGuiParameters = p;
+        
+        commonShaderSrc = STRINGIFY(
             /*
              DoF with bokeh GLSL shader v2.4
              by Martins Upitis (martinsh) (devlog-martinsh.blogspot.com)
@@ -82,6 +104,8 @@ namespace itg
 
             uniform sampler2D bgl_RenderedTexture;
             uniform sampler2D bgl_DepthTexture;
+            uniform sampler2D bgl_LinearDepthTexture;
+            uniform bool useLinearDepth;
             uniform float bgl_RenderedTextureWidth;
             uniform float bgl_RenderedTextureHeight;
                                                      
@@ -98,9 +122,14 @@ namespace itg
             uniform float focalLength; //focal length in mm
             uniform float fstop; //f-stop value
             uniform bool showFocus; //show debug focus point and focal range (red = focal point, green = focal range)
+            uniform float patternRotation; //fraction of the step between ring samples to rotate them by
+            uniform sampler2D noiseTex; //blue noise, r and g are independent
+            uniform bool useNoiseTexture;
+            uniform float noiseSize;
 
             /* 
             make sure that these two values are the same for your camera, otherwise distances will be wrong.
+            not used when drawing with PostProcessing::begin(cam) as the depth is already linear then.
             */
 
             float znear = 0.1; //camera clipping start
@@ -109,10 +138,10 @@ namespace itg
             //------------------------------------------
             //user variables
 
-            int samples = 3; //samples on the first ring
-            int rings = 3; //ring count
+            const int samples = SAMPLES; //samples on the first ring
+            const int rings = RINGS; //ring count
 
-            bool manualdof = false; //manual dof calculation
+            const bool manualdof = MANUALDOF; //manual dof calculation
             float ndofstart = 1.0; //near dof blur start
             float ndofdist = 2.0; //near dof blur falloff distance
             float fdofstart = 1.0; //far dof blur start
@@ -125,7 +154,7 @@ namespace itg
             float vignin = 0.0; //vignetting inner border
             float vignfade = 22.0; //f-stops till vignete fades
 
-            bool autofocus = false; //use autofocus in shader? disable if you use external focalDepth value
+            const bool autofocus = AUTOFOCUS; //use autofocus in shader? disable if you use external focalDepth value
             vec2 focus = vec2(0.5,0.5); // autofocus point on screen (0.0,0.0 - left lower corner, 1.0,1.0 - upper right)
             float maxblur = 1.0; //clamp value of max blur (0.0 = no blur,1.0 default)
 
@@ -135,10 +164,10 @@ namespace itg
             float bias = 0.5; //bokeh edge bias
             float fringe = 0.7; //bokeh chromatic aberration/fringing
 
-            bool noise = true; //use noise instead of pattern for sample dithering
+            const bool noise = NOISE; //use noise instead of pattern for sample dithering
             float namount = 0.0001; //dither amount
 
-            bool depthblur = false; //blur the depth buffer?
+            const bool depthblur = DEPTHBLUR; //blur the depth buffer?
             float dbsize = 1.25; //depthblursize
 
             /*
@@ -214,7 +243,7 @@ namespace itg
                 
                 for( int i=0; i<9; i++ )
                 {
-                    float tmp = texture2D(bgl_DepthTexture, coords + offset[i]).r;
+                    float tmp = useLinearDepth ? texture2D(bgl_LinearDepthTexture, coords + offset[i]).r : texture2D(bgl_DepthTexture, coords + offset[i]).r;
                     d += tmp * kernel[i];
                 }
                 
@@ -241,6 +270,10 @@ namespace itg
                 float noiseX = ((fract(1.0-coord.s*(width/2.0))*0.25)+(fract(coord.t*(height/2.0))*0.75))*2.0-1.0;
                 float noiseY = ((fract(1.0-coord.s*(width/2.0))*0.75)+(fract(coord.t*(height/2.0))*0.25))*2.0-1.0;
                 
+                if (noise && useNoiseTexture)
+                {
+                    return texture2D(noiseTex, coord * vec2(width, height) / noiseSize).rg * 2.0 - 1.0;
+                }
                 if (noise)
                 {
                     noiseX = clamp(fract(sin(dot(coord ,vec2(12.9898,78.233))) * 43758.5453),0.0,1.0)*2.0-1.0;
@@ -265,6 +298,12 @@ namespace itg
             {
                 return -zfar * znear / (depth * (zfar - znear) - zfar);
             }
+            
+            float sceneDepth(vec2 coords)
+            {
+                if (useLinearDepth) return texture2D(bgl_LinearDepthTexture, coords).r;
+                return linearize(texture2D(bgl_DepthTexture, coords).x);
+            }
 
             float vignette()
             {
@@ -273,15 +312,15 @@ namespace itg
                 return clamp(dist,0.0,1.0);
             }
                                                      
-            void main() 
+            float blurAt(vec2 coords, out float depth) //dof blur factor calculation
             {
                 //scene depth calculation
                 
-                float depth = linearize(texture2D(bgl_DepthTexture,gl_TexCoord[0].xy).x);
+                depth = sceneDepth(coords);
                 
                 if (depthblur)
                 {
-                    depth = linearize(bdepth(gl_TexCoord[0].xy));
+                    depth = useLinearDepth ? bdepth(coords) : linearize(bdepth(coords));
                 }
                 
                 //focal plane calculation
@@ -290,11 +329,9 @@ namespace itg
                 
                 if (autofocus)
                 {
-                    fDepth = linearize(texture2D(bgl_DepthTexture,focus).x);
+                    fDepth = sceneDepth(focus);
                 }
                 
-                //dof blur factor calculation
-                
                 float blur = 0.0;
                 
                 if (manualdof)
@@ -318,51 +355,80 @@ namespace itg
                     blur = abs(a-b)*c;
                 }
                 
-                blur = clamp(blur,0.0,1.0);
-                
-                // calculation of pattern for ditering
-                
-                vec2 noise = rand(gl_TexCoord[0].xy)*namount*blur;
-                
-                // getting blur x and y step factor
-                
-                float w = (1.0/width)*blur*maxblur+noise.x;
-                float h = (1.0/height)*blur*maxblur+noise.y;
-                
-                // calculation of final color
+                return clamp(blur,0.0,1.0);
+            }
+            
+            float tileCoc(vec2 coords) //used by the tile classification
+            {
+                float depth;
+                return blurAt(coords, depth);
+            }
+        );
+        
+        mainShaderSrc = STRINGIFY(
+            uniform bool useTiles;
+            uniform sampler2D tTiles;
+            uniform vec2 tileScale;
+            uniform bool writeBlurToAlpha;
+                                         
+            void main() 
+            {
+                float depth = 0.0;
+                float blur = 0.0;
                 
                 vec3 col = vec3(0.0);
                 
-                if(blur < 0.05) //some optimization thingy
+                if (useTiles && texture2D(tTiles, gl_TexCoord[0].xy * tileScale).r < 0.05) //whole tile is in focus
                 {
                     col = texture2D(bgl_RenderedTexture, gl_TexCoord[0].xy).rgb;
                 }
                 
                 else
                 {
-                    col = texture2D(bgl_RenderedTexture, gl_TexCoord[0].xy).rgb;
-                    float s = 1.0;
-                    int ringsamples;
+                    blur = blurAt(gl_TexCoord[0].xy, depth);
+                    
+                    // calculation of pattern for ditering
+                    
+                    vec2 noise = rand(gl_TexCoord[0].xy)*namount*blur;
+                    
+                    // getting blur x and y step factor
+                    
+                    float w = (1.0/width)*blur*maxblur+noise.x;
+                    float h = (1.0/height)*blur*maxblur+noise.y;
                     
-                    for (int i = 1; i <= rings; i += 1)
-                    {   
-                        ringsamples = i * samples;
+                    // calculation of final color
+                    
+                    if(blur < 0.05) //some optimization thingy
+                    {
+                        col = texture2D(bgl_RenderedTexture, gl_TexCoord[0].xy).rgb;
+                    }
+                    
+                    else
+                    {
+                        col = texture2D(bgl_RenderedTexture, gl_TexCoord[0].xy).rgb;
+                        float s = 1.0;
+                        int ringsamples;
                         
-                        for (int j = 0 ; j < ringsamples ; j += 1)   
-                        {
-                            float step = PI*2.0 / float(ringsamples);
-                            float pw = (cos(float(j)*step)*float(i));
-                            float ph = (sin(float(j)*step)*float(i));
-                            float p = 1.0;
-                            if (pentagon)
-                            { 
-                                p = penta(vec2(pw,ph));
+                        for (int i = 1; i <= rings; i += 1)
+                        {   
+                            ringsamples = i * samples;
+                            
+                            for (int j = 0 ; j < ringsamples ; j += 1)   
+                            {
+                                float step = PI*2.0 / float(ringsamples);
+                                float pw = (cos((float(j)+patternRotation)*step)*float(i));
+                                float ph = (sin((float(j)+patternRotation)*step)*float(i));
+                                float p = 1.0;
+                                if (pentagon)
+                                { 
+                                    p = penta(vec2(pw,ph));
+                                }
+                                col += color(gl_TexCoord[0].xy + vec2(pw*w,ph*h),blur)*mix(1.0,(float(i))/(float(rings)),bias)*p;  
+                                s += 1.0*mix(1.0,(float(i))/(float(rings)),bias)*p;   
                             }
-                            col += color(gl_TexCoord[0].xy + vec2(pw*w,ph*h),blur)*mix(1.0,(float(i))/(float(rings)),bias)*p;  
-                            s += 1.0*mix(1.0,(float(i))/(float(rings)),bias)*p;   
                         }
+                        col /= s; //divide by sample count
                     }
-                    col /= s; //divide by sample count
                 }
                 
                 if (showFocus)
@@ -376,33 +442,150 @@ namespace itg
                 }
                 
                 gl_FragColor.rgb = col;
-                gl_FragColor.a = 1.0;
+                // tells the accumulator only the blurred part is noisy
+                gl_FragColor.a = writeBlurToAlpha ? smoothstep(0.0, 0.05, blur) : 1.0;
             }
         );
         
-        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
-        shader.linkProgram();	
+        setQuality(QUALITY_MEDIUM);
+    }
+    
+    void DofAltPass::setQuality(Quality quality)
+    {
+        switch (quality)
+        {
+            case QUALITY_LOW:
+                setSettings(Settings(3, 2, false, false, false, false));
+                break;
+                
+            case QUALITY_MEDIUM:
+                setSettings(Settings(3, 3, false, true, false, false));
+                break;
+                
+            case QUALITY_HIGH:
+                setSettings(Settings(4, 4, false, true, true, false));
+                break;
+                
+            default:
+                break;
+        }
+        this->quality = quality;
+    }
+    
+    void DofAltPass::setSettings(const Settings& settings)
+    {
+        this->settings = settings;
+        quality = QUALITY_CUSTOM;
+        shader = getProgram(settings, false);
+    }
+    
+    shared_ptr<ofShader> DofAltPass::getProgram(const Settings& settings, bool tiles)
+    {
+        shared_ptr<ofShader>& program = programs[make_pair(settings, tiles)];
+        if (!program)
+        {
+            ostringstream oss;
+            oss << "#define SAMPLES " << max(settings.samples, 1) << endl;
+            oss << "#define RINGS " << max(settings.rings, 1) << endl;
+            oss << "#define AUTOFOCUS " << (settings.autofocus ? "true" : "false") << endl;
+            oss << "#define NOISE " << (settings.noise ? "true" : "false") << endl;
+            oss << "#define DEPTHBLUR " << (settings.depthBlur ? "true" : "false") << endl;
+            oss << "#define MANUALDOF " << (settings.manualDof ? "true" : "false") << endl;
+            oss << commonShaderSrc;
+            // the blurred depth reads up to 1.25 pixels away
+            if (tiles) oss << CocTiles::getReductionSrc(settings.depthBlur ? 2 : 0);
+            else oss << mainShaderSrc;
+            
+            program = shared_ptr<ofShader>(new ofShader());
+            program->setupShaderFromSource(GL_FRAGMENT_SHADER, oss.str());
+            program->linkProgram();
+        }
+        return program;
+    }
+    
+    void DofAltPass::latchParameters()
+    {
+        // only the fields the gui changed are published so sets from other threads aren't undone
+        const Parameters edited = guiParameters;
+        const Parameters& latched = latchedGuiParameters;
+        if (edited.focalDepth != latched.focalDepth) setFocalDepth(edited.focalDepth);
+        if (edited.focalLength != latched.focalLength) setFocalLength(edited.focalLength);
+        if (edited.fStop != latched.fStop) setFStop(edited.fStop);
+        if (edited.showFocus != latched.showFocus) setShowFocus(edited.showFocus);
+        
+        parameters.latch();
+        guiParameters = latchedGuiParameters = parameters.getReadRef();
     }
     
     void DofAltPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth)
     {
-        writeFbo.begin();
+        const Parameters& p = parameters.getReadRef();
+        // the focus debug view needs the blur of every pixel
+        bool useTiles = tileClassification && !p.showFocus;
+        if (useTiles)
+        {
+            shared_ptr<ofShader> tileShader = getProgram(settings, true);
+            tiles.begin(*tileShader, writeFbo.getWidth(), writeFbo.getHeight());
+            tileShader->setUniformTexture("bgl_DepthTexture", depth, 0);
+            tileShader->setUniform1i("useLinearDepth", depthPyramid ? 1 : 0);
+            if (depthPyramid) tileShader->setUniformTexture("bgl_LinearDepthTexture", depthPyramid->getTexture(), 1);
+            tileShader->setUniform1f("bgl_RenderedTextureWidth", aspect.x);
+            tileShader->setUniform1f("bgl_RenderedTextureHeight", aspect.y);
+            tileShader->setUniform1f("focalDepth", p.focalDepth);
+            tileShader->setUniform1f("focalLength", p.focalLength);
+            tileShader->setUniform1f("fstop", p.fStop);
+            tiles.end(*tileShader);
+        }
+        
+        if (accumulate) accumulator.getFrameFbo(writeFbo).begin();
+        else beginTarget(writeFbo);
         
-        shader.begin();
+        shader->begin();
         
-        shader.setUniformTexture("bgl_RenderedTexture", readFbo.getTexture(), 0);
-        shader.setUniformTexture("bgl_DepthTexture", depth, 1);
-        shader.setUniform1f("bgl_RenderedTextureWidth", aspect.x);
-        shader.setUniform1f("bgl_RenderedTextureHeight", aspect.y);
+        shader->setUniformTexture("bgl_RenderedTexture", readFbo.getTexture(), 0);
+        shader->setUniformTexture("bgl_DepthTexture", depth, 1);
+        shader->setUniform1i("useLinearDepth", depthPyramid ? 1 : 0);
+        if (depthPyramid) shader->setUniformTexture("bgl_LinearDepthTexture", depthPyramid->getTexture(), 3);
+        shader->setUniform1f("bgl_RenderedTextureWidth", aspect.x);
+        shader->setUniform1f("bgl_RenderedTextureHeight", aspect.y);
         
-        shader.setUniform1f("focalDepth", focalDepth);  //focal distance value in meters, but you may use autofocus option below
-        shader.setUniform1f("focalLength", focalLength); //focal length in mm
-        shader.setUniform1f("fstop", fStop); //f-stop value
-        shader.setUniform1f("showFocus", showFocus); //show debug focus point and focal range (red = focal point, green = focal range)
+        shader->setUniform1f("focalDepth", p.focalDepth);  //focal distance value in meters, but you may use autofocus option below
+        shader->setUniform1f("focalLength", p.focalLength); //focal length in mm
+        shader->setUniform1f("fstop", p.fStop); //f-stop value
+        shader->setUniform1f("showFocus", p.showFocus); //show debug focus point and focal range (red = focal point, green = focal range)
+        shader->setUniform1i("useTiles", useTiles ? 1 : 0);
+        if (useTiles)
+        {
+            shader->setUniformTexture("tTiles", tiles.getTexture(), 2);
+            shader->setUniform2f("tileScale", tiles.getScale().x, tiles.getScale().y);
+        }
+        shader->setUniform1f("patternRotation", accumulate ? accumulator.getPatternRotation() : 0.f);
+        shader->setUniform1i("writeBlurToAlpha", accumulate ? 1 : 0);
+        shader->setUniform1i("useNoiseTexture", blueNoise && noiseTextures ? 1 : 0);
+        if (blueNoise && noiseTextures)
+        {
+            shader->setUniformTexture("noiseTex", noiseTextures->getBlueNoise(), 4);
+            shader->setUniform1f("noiseSize", NoiseTextures::BLUE_NOISE_SIZE);
+        }
 
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
-        shader.end();
-        writeFbo.end();
+        shader->end();
+        if (accumulate) accumulator.getFrameFbo(writeFbo).end();
+        else endTarget(writeFbo);
+        
+        if (accumulate)
+        {
+            ofTexture& blurred = accumulator.resolve(depth, frameInfo);
+            beginTarget(writeFbo);
+            ofClear(0, 255);
+            // the history keeps its depth in alpha
+            glPushAttrib(GL_COLOR_BUFFER_BIT);
+            glDisable(GL_BLEND);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE);
+            blurred.draw(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+            glPopAttrib();
+            endTarget(writeFbo);
+        }
     }
 }
\ No newline at end of file
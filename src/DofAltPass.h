@@ -33,6 +33,9 @@
 
 #include "RenderPass.h"
 #include "ofShader.h"
+#include "CocTiles.h"
+#include "TemporalAccumulator.h"
+#include "TripleBuffer.h"
 
 namespace itg
 {
@@ -44,31 +47,112 @@ namespace itg
     public:
         typedef shared_ptr<DofAltPass> Ptr;
         
+        enum Quality
+        {
+            QUALITY_LOW,
+            QUALITY_MEDIUM,
+            QUALITY_HIGH,
+            QUALITY_CUSTOM
+        };
+        
+        /*
+         * Options that are compiled into the shader, each combination is
+         * compiled the first time it is used and then cached.
+         */
+        struct Settings
+        {
+            Settings(int samples = 3, int rings = 3, bool autofocus = false, bool noise = true, bool depthBlur = false, bool manualDof = false);
+            
+            bool operator<(const Settings& other) const;
+            
+            int samples; //samples on the first ring
+            int rings; //ring count
+            bool autofocus; //use autofocus in shader, uses the depth at the centre of the screen instead of focalDepth
+            bool noise; //use noise instead of pattern for sample dithering
+            bool depthBlur; //blur the depth buffer
+            bool manualDof; //manual dof calculation
+        };
+        
+        struct Parameters
+        {
+            float focalDepth; //focal distance value in meters, but you may use autofocus option below
+            float focalLength; //focal length in mm
+            float fStop; //f-stop value
+            bool showFocus; //show debug focus point and focal range (red = focal point, green = focal range
+        };
+        
         DofAltPass(const ofVec2f& aspect, bool arb, float focalDepth = 1.f, float focalLength = 500.f, float fStop = 3.f, bool showFocus = false);
         
         void render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth);
         
-        float& getFocalDepthRef() { return focalDepth; }
-        float getFocalDepth() const { return focalDepth; }
-        void setFocalDepth(float focalDepth) { this->focalDepth = focalDepth; }
+        // uses the near and far of the camera given to PostProcessing::begin(cam)
+        bool usesDepthPyramid() const { return true; }
         
-        float& getFocalLengthRef() { return focalLength; }
-        float getFocalLength() const { return focalLength; }
-        void setFocalLength(float focalLength) { this->focalLength = focalLength; }
+        // getters and setters can be called from any thread, set values are
+        // used from the next PostProcessing::begin(). The Ref getters are for
+        // a gui on the render thread: they edit a copy that begin() publishes
+        // like a set before latching and then refreshes with the latest values.
+        float& getFocalDepthRef() { return guiParameters.focalDepth; }
+        float getFocalDepth() const { return parameters.getLatest().focalDepth; }
+        void setFocalDepth(float focalDepth) { parameters.modify([focalDepth](Parameters& p) { p.focalDepth = focalDepth; }); }
+        
+        float& getFocalLengthRef() { return guiParameters.focalLength; }
+        float getFocalLength() const { return parameters.getLatest().focalLength; }
+        void setFocalLength(float focalLength) { parameters.modify([focalLength](Parameters& p) { p.focalLength = focalLength; }); }
     
-        float& getFStopRef() { return fStop; }
-        float getFStop() const { return fStop; }
-        void setFStop(float fStop) { this->fStop = fStop; }
+        float& getFStopRef() { return guiParameters.fStop; }
+        float getFStop() const { return parameters.getLatest().fStop; }
+        void setFStop(float fStop) { parameters.modify([fStop](Parameters& p) { p.fStop = fStop; }); }
+        
+        bool& getShowFocusRef() { return guiParameters.showFocus; }
+        bool getShowFocus() const { return parameters.getLatest().showFocus; }
+        void setShowFocus(bool showFocus) { parameters.modify([showFocus](Parameters& p) { p.showFocus = showFocus; }); }
+        
+        void setParameters(const Parameters& parameters) { this->parameters.write(parameters); }
+        Parameters getLatestParameters() const { return parameters.getLatest(); }
+        void latchParameters();
         
-        bool& getShowFocusRef() { return showFocus; }
-        bool getShowFocus() const { return showFocus; }
-        void setShowFocus(bool showFocus) { this->showFocus = showFocus; }
+        // low: 9 samples, medium: 18 samples, high: 40 samples with depth blur
+        void setQuality(Quality quality);
+        Quality getQuality() const { return quality; }
+        
+        // switches to QUALITY_CUSTOM
+        void setSettings(const Settings& settings);
+        const Settings& getSettings() const { return settings; }
+        
+        // copy 16x16 tiles that are entirely in focus instead of computing their blur and gathering
+        bool getTileClassification() const { return tileClassification; }
+        void setTileClassification(bool tileClassification) { this->tileClassification = tileClassification; }
+        
+        // rotate the rings each frame and average them over time
+        bool getAccumulate() const { return accumulate; }
+        void setAccumulate(bool accumulate) { this->accumulate = accumulate; }
+        TemporalAccumulator& getAccumulator() { return accumulator; }
+        
+        // dither with PostProcessing's blue noise texture instead of a sin hash when settings.noise is on
+        bool getBlueNoise() const { return blueNoise; }
+        void setBlueNoise(bool blueNoise) { this->blueNoise = blueNoise; }
+        bool usesNoiseTextures() const { return blueNoise; }
         
     private:
-        ofShader shader;
-        float focalDepth; //focal distance value in meters, but you may use autofocus option below
-        float focalLength; //focal length in mm
-        float fStop; //f-stop value
-        bool showFocus; //show debug focus point and focal range (red = focal point, green = focal range
+        // tiles selects the tile reduction program rather than the dof one
+        shared_ptr<ofShader> getProgram(const Settings& settings, bool tiles);
+        
+        string commonShaderSrc;
+        string mainShaderSrc;
+        map<pair<Settings, bool>, shared_ptr<ofShader> > programs;
+        shared_ptr<ofShader> shader;
+        CocTiles tiles;
+        bool tileClassification;
+        TemporalAccumulator accumulator;
+        bool accumulate;
+        bool blueNoise;
+        Settings settings;
+        Quality quality;
+        
+        TripleBuffer<Parameters> parameters;
+        // render thread only, what the Ref getters edit and what they held after the last latch
+        Parameters guiParameters;
+        Parameters latchedGuiParameters;
     };
 }
\ No newline at end of file
@@ -35,8 +35,13 @@
 namespace itg
 {
     DofPass::DofPass(const ofVec2f& aspect, bool arb, float focus, float aperture, float maxBlur) :
-        focus(focus), aperture(aperture), maxBlur(maxBlur), RenderPass(aspect, arb, "dof")
+        tileClassification(true), RenderPass(aspect, arb, "dof")
     {
+        Parameters p = { focus, aperture, maxBlur };
+        parameters.write(p);
+        parameters.latch();
+        guiParameters = latchedGuiParameters = p;
+        
         string fragShaderSrc = STRINGIFY(
             uniform sampler2D tColor;
             uniform sampler2D tDepth;
@@ -47,8 +52,18 @@ namespace itg
             uniform float focus;
             uniform float aspect;
             
+            uniform bool useTiles;
+            uniform sampler2D tTiles;
+            uniform vec2 tileScale;
+            uniform float inFocus; // largest blur that moves no sample by more than half a pixel
+            
             void main() {
                 vec2 vUv = gl_TexCoord[0].st;
+                
+                if ( useTiles && texture2D( tTiles, vUv * tileScale ).r < inFocus ) {
+                    gl_FragColor = vec4( texture2D( tColor, vUv ).rgb, 1.0 );
+                    return;
+                }
                                     
                 vec2 aspectcorrect = vec2( 1.0, aspect );
                 
@@ -117,30 +132,77 @@ namespace itg
         
         shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
         shader.linkProgram();
+        
+        string tileShaderSrc = STRINGIFY(
+            uniform sampler2D tDepth;
+            uniform float maxBlur;
+            uniform float aperture;
+            uniform float focus;
+            
+            float tileCoc(vec2 uv)
+            {
+                return abs( clamp( ( texture2D( tDepth, uv ).x - focus ) * aperture, -maxBlur, maxBlur ) );
+            }
+        );
+        
+        tileShader.setupShaderFromSource(GL_FRAGMENT_SHADER, tileShaderSrc + CocTiles::getReductionSrc());
+        tileShader.linkProgram();
 
 #ifdef _ITG_TWEAKABLE
-        addParameter("focus", this->focus, "min=0.95 max=1");
-        addParameter("aperture", this->aperture, "min=0 max=1");
-        addParameter("maxBlur", this->maxBlur, "min=0 max=1");
+        addParameter("focus", guiParameters.focus, "min=0.95 max=1");
+        addParameter("aperture", guiParameters.aperture, "min=0 max=1");
+        addParameter("maxBlur", guiParameters.maxBlur, "min=0 max=1");
 #endif
     }
     
+    void DofPass::latchParameters()
+    {
+        // only the fields the gui changed are published so sets from other threads aren't undone
+        const Parameters edited = guiParameters;
+        const Parameters& latched = latchedGuiParameters;
+        if (edited.focus != latched.focus) setFocus(edited.focus);
+        if (edited.aperture != latched.aperture) setAperture(edited.aperture);
+        if (edited.maxBlur != latched.maxBlur) setMaxBlur(edited.maxBlur);
+        
+        parameters.latch();
+        guiParameters = latchedGuiParameters = parameters.getReadRef();
+    }
+    
     void DofPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex)
-    {            
-        writeFbo.begin();
+    {
+        const Parameters& p = parameters.getReadRef();
+        if (tileClassification)
+        {
+            tiles.begin(tileShader, writeFbo.getWidth(), writeFbo.getHeight());
+            tileShader.setUniformTexture("tDepth", depthTex, 0);
+            tileShader.setUniform1f("aperture", p.aperture);
+            tileShader.setUniform1f("focus", p.focus);
+            tileShader.setUniform1f("maxBlur", p.maxBlur);
+            tiles.end(tileShader);
+        }
+        
+        beginTarget(writeFbo);
         
         shader.begin();
                     
         shader.setUniformTexture("tColor", readFbo.getTexture(), 0);
         shader.setUniformTexture("tDepth", depthTex, 1);
-        shader.setUniform1f("aperture", aperture);
-        shader.setUniform1f("focus", focus);
-        shader.setUniform1f("maxBlur", maxBlur);
+        shader.setUniform1f("aperture", p.aperture);
+        shader.setUniform1f("focus", p.focus);
+        shader.setUniform1f("maxBlur", p.maxBlur);
         shader.setUniform1f("aspect", aspect.x / aspect.y);
+        shader.setUniform1i("useTiles", tileClassification ? 1 : 0);
+        if (tileClassification)
+        {
+            shader.setUniformTexture("tTiles", tiles.getTexture(), 2);
+            shader.setUniform2f("tileScale", tiles.getScale().x, tiles.getScale().y);
+            // outermost samples are 0.4 * blur away in texture coordinates
+            shader.setUniform1f("inFocus", 0.5f / (0.4f * writeFbo.getWidth()));
+        }
         
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
\ No newline at end of file
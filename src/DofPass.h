@@ -33,6 +33,8 @@
 
 #include "RenderPass.h"
 #include "ofShader.h"
+#include "CocTiles.h"
+#include "TripleBuffer.h"
 
 namespace itg
 {
@@ -44,28 +46,55 @@ namespace itg
     public:
         typedef shared_ptr<DofPass> Ptr;
         
+        struct Parameters
+        {
+            float focus;
+            float aperture;
+            float maxBlur;
+        };
+        
         DofPass(const ofVec2f& aspect, bool arb, float focus = 0.985, float aperture = 0.8, float maxBlur = 0.6);
         
         void render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex);
         
-        float getFocus() const { return focus; }
-        void setFocus(float focus) { this->focus = focus; }
+        bool usesDepth() const { return !isIdentity(); }
+        
+        // getters and setters can be called from any thread, set values are
+        // used from the next PostProcessing::begin(). The Ref getters edit a
+        // render thread copy for a gui, see DofAltPass.
+        float getFocus() const { return parameters.getLatest().focus; }
+        void setFocus(float focus) { parameters.modify([focus](Parameters& p) { p.focus = focus; }); }
+        
+        float getAperture() const { return parameters.getLatest().aperture; }
+        void setAperture(float aperture) { parameters.modify([aperture](Parameters& p) { p.aperture = aperture; }); }
+        
+        float getMaxBlur() const { return parameters.getLatest().maxBlur; }
+        void setMaxBlur(float maxBlur) { parameters.modify([maxBlur](Parameters& p) { p.maxBlur = maxBlur; }); }
+        
+        float& getFocusRef() { return guiParameters.focus; }
+        float& getApertureRef() { return guiParameters.aperture; }
+        float& getMaxBlurRef() { return guiParameters.maxBlur; }
         
-        float getAperture() const { return aperture; }
-        void setAperture(float aperture) { this->aperture = aperture; }
+        void setParameters(const Parameters& parameters) { this->parameters.write(parameters); }
+        Parameters getLatestParameters() const { return parameters.getLatest(); }
+        void latchParameters();
         
-        float getMaxBlur() const { return maxBlur; }
-        void setMaxBlur(float maxBlur) { this->maxBlur = maxBlur; }
+        // every sample lands on the pixel itself
+        bool isIdentity() const { return parameters.getReadRef().aperture == 0.f || parameters.getReadRef().maxBlur == 0.f; }
         
-        float& getFocusRef() { return focus; }
-        float& getApertureRef() { return aperture; }
-        float& getMaxBlurRef() { return maxBlur; }
+        // copy in focus 16x16 tiles instead of running the full 41 tap gather
+        bool getTileClassification() const { return tileClassification; }
+        void setTileClassification(bool tileClassification) { this->tileClassification = tileClassification; }
         
     private:
         ofShader shader;
+        ofShader tileShader;
+        CocTiles tiles;
+        bool tileClassification;
         
-        float focus;
-        float aperture;
-        float maxBlur;
+        TripleBuffer<Parameters> parameters;
+        // render thread only, what the Ref getters edit and what they held after the last latch
+        Parameters guiParameters;
+        Parameters latchedGuiParameters;
     };
 }
\ No newline at end of file
@@ -87,6 +87,91 @@ namespace itg
             }
         );
         
+#if !defined(TARGET_OPENGLES) && defined(GL_COMPUTE_SHADER)
+        // the same filter with each 16x16 tile's intensities plus a one pixel
+        // border loaded into shared memory once instead of nine fetches a pixel
+        string computeShaderSrc = STRINGIFY(
+            layout(local_size_x = 16, local_size_y = 16) in;
+            
+            uniform SAMPLER_TYPE tex;
+            layout(rgba8) writeonly uniform IMAGE_TYPE outImage;
+            uniform ivec2 size;
+            uniform float hue;
+            uniform float saturation;
+            
+            shared float intensity[18][18];
+            
+            const mat3 G[9] = mat3[]( mat3( 0.3535533845424652, 0, -0.3535533845424652, 0.5, 0, -0.5, 0.3535533845424652, 0, -0.3535533845424652 ),
+                                      mat3( 0.3535533845424652, 0.5, 0.3535533845424652, 0, 0, 0, -0.3535533845424652, -0.5, -0.3535533845424652 ),
+                                      mat3( 0, 0.3535533845424652, -0.5, -0.3535533845424652, 0, 0.3535533845424652, 0.5, -0.3535533845424652, 0 ),
+                                      mat3( 0.5, -0.3535533845424652, 0, -0.3535533845424652, 0, 0.3535533845424652, 0, 0.3535533845424652, -0.5 ),
+                                      mat3( 0, -0.5, 0, 0.5, 0, 0.5, 0, -0.5, 0 ),
+                                      mat3( -0.5, 0, 0.5, 0, 0, 0, 0.5, 0, -0.5 ),
+                                      mat3( 0.1666666716337204, -0.3333333432674408, 0.1666666716337204, -0.3333333432674408, 0.6666666865348816, -0.3333333432674408, 0.1666666716337204, -0.3333333432674408, 0.1666666716337204 ),
+                                      mat3( -0.3333333432674408, 0.1666666716337204, -0.3333333432674408, 0.1666666716337204, 0.6666666865348816, 0.1666666716337204, -0.3333333432674408, 0.1666666716337204, -0.3333333432674408 ),
+                                      mat3( 0.3333333432674408, 0.3333333432674408, 0.3333333432674408, 0.3333333432674408, 0.3333333432674408, 0.3333333432674408, 0.3333333432674408, 0.3333333432674408, 0.3333333432674408 ));
+            
+            vec3 hsv(float h,float s,float v) { return mix(vec3(1.),clamp((abs(fract(h+vec3(3.,2.,1.)/3.)*6.-3.)-1.),0.,1.),s)*v; }
+            
+            void main(void)
+            {
+                ivec2 origin = ivec2(gl_WorkGroupID.xy) * 16 - 1;
+                for (uint i = gl_LocalInvocationIndex; i < 18u * 18u; i += 256u)
+                {
+                    ivec2 p = clamp(origin + ivec2(i % 18u, i / 18u), ivec2(0), size - 1);
+                    intensity[i / 18u][i % 18u] = length(TEXEL_FETCH(tex, p).rgb);
+                }
+                barrier();
+                
+                ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+                if (any(greaterThanEqual(pixel, size))) return;
+                
+                ivec2 local = ivec2(gl_LocalInvocationID.xy) + 1;
+                mat3 I;
+                for (int i=0; i<3; i++)
+                {
+                    for (int j=0; j<3; j++)
+                    {
+                        I[i][j] = intensity[local.y + j - 1][local.x + i - 1];
+                    }
+                }
+                
+                float cnv[9];
+                for (int i=0; i<9; i++)
+                {
+                    float dp3 = dot(G[i][0], I[0]) + dot(G[i][1], I[1]) + dot(G[i][2], I[2]);
+                    cnv[i] = dp3 * dp3;
+                }
+                
+                float M = (cnv[0] + cnv[1]) + (cnv[2] + cnv[3]);
+                float S = (cnv[4] + cnv[5]) + (cnv[6] + cnv[7]) + (cnv[8] + M);
+                
+                imageStore(outImage, pixel, vec4(hsv(hue, saturation, sqrt(M/S)), 1.0));
+            }
+        );
+        
+        if (isComputeAvailable())
+        {
+            ostringstream oss;
+            oss << "#version 430" << endl;
+            if (arb)
+            {
+                oss << "#define SAMPLER_TYPE sampler2DRect" << endl;
+                oss << "#define IMAGE_TYPE image2DRect" << endl;
+                oss << "#define TEXEL_FETCH(s, p) texelFetch(s, p)" << endl;
+            }
+            else
+            {
+                oss << "#define SAMPLER_TYPE sampler2D" << endl;
+                oss << "#define IMAGE_TYPE image2D" << endl;
+                oss << "#define TEXEL_FETCH(s, p) texelFetch(s, p, 0)" << endl;
+            }
+            oss << computeShaderSrc;
+            computeShader.setupShaderFromSource(GL_COMPUTE_SHADER, oss.str());
+            computeShader.linkProgram();
+        }
+#endif
+        
         ostringstream oss;
         oss << "#version 120" << endl;
         if (arb)
@@ -113,7 +198,15 @@ namespace itg
     
     void EdgePass::render(ofFbo& readFbo, ofFbo& writeFbo)
     {
-        writeFbo.begin();
+#if !defined(TARGET_OPENGLES) && defined(GL_COMPUTE_SHADER)
+        if (useCompute())
+        {
+            renderCompute(readFbo, writeFbo);
+            return;
+        }
+#endif
+        
+        beginTarget(writeFbo);
         
         shader.begin();
         shader.setUniformTexture("tex", readFbo.getTexture(), 0);
@@ -127,6 +220,24 @@ namespace itg
         
         shader.end();
         
-        writeFbo.end();
+        endTarget(writeFbo);
     }
+    
+#if !defined(TARGET_OPENGLES) && defined(GL_COMPUTE_SHADER)
+    void EdgePass::renderCompute(ofFbo& readFbo, ofFbo& writeFbo)
+    {
+        computeShader.begin();
+        computeShader.setUniformTexture("tex", readFbo.getTexture(), 0);
+        computeShader.setUniform2i("size", writeFbo.getWidth(), writeFbo.getHeight());
+        computeShader.setUniform1f("hue", hue);
+        computeShader.setUniform1f("saturation", saturation);
+        computeShader.setUniform1i("outImage", 0);
+        glBindImageTexture(0, writeFbo.getTexture().getTextureData().textureID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        computeShader.dispatchCompute((writeFbo.getWidth() + 15) / 16, (writeFbo.getHeight() + 15) / 16, 1);
+        computeShader.end();
+        
+        // later passes sample or draw into the result
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+    }
+#endif
 }
@@ -56,7 +56,16 @@ namespace itg
         
         bool hasArbShader() { return true; }
         
+#if !defined(TARGET_OPENGLES) && defined(GL_COMPUTE_SHADER)
+        bool hasComputeShader() { return true; }
+#endif
+        
     private:
+#if !defined(TARGET_OPENGLES) && defined(GL_COMPUTE_SHADER)
+        void renderCompute(ofFbo& readFbo, ofFbo& writeFbo);
+        
+        ofShader computeShader;
+#endif
         ofShader shader;
         float hue, saturation;
     };
@@ -137,7 +137,7 @@ namespace itg
 
     void FakeSSSPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         shader.begin();
         
@@ -155,6 +155,6 @@ namespace itg
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
\ No newline at end of file
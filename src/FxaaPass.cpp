@@ -33,38 +33,52 @@
 
 namespace itg
 {
-    FxaaPass::FxaaPass(const ofVec2f& aspect, bool arb) : RenderPass(aspect, arb, "fxaa")
+    FxaaPass::FxaaPass(const ofVec2f& aspect, bool arb, Quality quality) : quality(quality), RenderPass(aspect, arb, "fxaa")
     {
-        string fragShaderSrc = STRINGIFY(
+        fragShaderSrc = STRINGIFY(
              uniform SAMPLER_TYPE tDiffuse;
              uniform vec2 resolution;
              
              varying vec2 vUv;
              
              const float FXAA_REDUCE_MIN = 1.0/128.0;
-             const float FXAA_REDUCE_MUL = 1.0/8.0;
-             const float FXAA_SPAN_MAX = 8.0;
+             const float FXAA_REDUCE_MUL = REDUCE_MUL;
+             const float FXAA_SPAN_MAX = SPAN_MAX;
+             const float FXAA_EDGE_THRESHOLD = EDGE_THRESHOLD; // 0 filters every pixel
+             const float FXAA_EDGE_THRESHOLD_MIN = EDGE_THRESHOLD_MIN;
+             const bool FXAA_TWO_TAP = TWO_TAP;
+             const bool LUMA_IN_ALPHA = LUMA_ALPHA;
+             
+             float getLuma(vec4 rgba) {
+                 if ( LUMA_IN_ALPHA ) return rgba.w;
+                 return dot( rgba.xyz, vec3( 0.299, 0.587, 0.114 ) );
+             }
              
              void main() {
                  
-                 vec3 rgbNW = TEXTURE_FN( tDiffuse, ( gl_FragCoord.xy + vec2( -1.0, -1.0 ) ) * resolution ).xyz;
-                 vec3 rgbNE = TEXTURE_FN( tDiffuse, ( gl_FragCoord.xy + vec2( 1.0, -1.0 ) ) * resolution ).xyz;
-                 vec3 rgbSW = TEXTURE_FN( tDiffuse, ( gl_FragCoord.xy + vec2( -1.0, 1.0 ) ) * resolution ).xyz;
-                 vec3 rgbSE = TEXTURE_FN( tDiffuse, ( gl_FragCoord.xy + vec2( 1.0, 1.0 ) ) * resolution ).xyz;
+                 vec4 rgbaNW = TEXTURE_FN( tDiffuse, ( gl_FragCoord.xy + vec2( -1.0, -1.0 ) ) * resolution );
+                 vec4 rgbaNE = TEXTURE_FN( tDiffuse, ( gl_FragCoord.xy + vec2( 1.0, -1.0 ) ) * resolution );
+                 vec4 rgbaSW = TEXTURE_FN( tDiffuse, ( gl_FragCoord.xy + vec2( -1.0, 1.0 ) ) * resolution );
+                 vec4 rgbaSE = TEXTURE_FN( tDiffuse, ( gl_FragCoord.xy + vec2( 1.0, 1.0 ) ) * resolution );
                  vec4 rgbaM  = TEXTURE_FN( tDiffuse,  gl_FragCoord.xy  * resolution );
                  vec3 rgbM  = rgbaM.xyz;
-                 float opacity  = rgbaM.w;
-                 
-                 vec3 luma = vec3( 0.299, 0.587, 0.114 );
+                 float opacity  = LUMA_IN_ALPHA ? 1.0 : rgbaM.w;
                  
-                 float lumaNW = dot( rgbNW, luma );
-                 float lumaNE = dot( rgbNE, luma );
-                 float lumaSW = dot( rgbSW, luma );
-                 float lumaSE = dot( rgbSE, luma );
-                 float lumaM  = dot( rgbM,  luma );
+                 float lumaNW = getLuma( rgbaNW );
+                 float lumaNE = getLuma( rgbaNE );
+                 float lumaSW = getLuma( rgbaSW );
+                 float lumaSE = getLuma( rgbaSE );
+                 float lumaM  = getLuma( rgbaM );
                  float lumaMin = min( lumaM, min( min( lumaNW, lumaNE ), min( lumaSW, lumaSE ) ) );
                  float lumaMax = max( lumaM, max( max( lumaNW, lumaNE) , max( lumaSW, lumaSE ) ) );
                  
+                 if ( FXAA_EDGE_THRESHOLD > 0.0 && lumaMax - lumaMin < max( FXAA_EDGE_THRESHOLD_MIN, lumaMax * FXAA_EDGE_THRESHOLD ) ) {
+                     
+                     gl_FragColor = vec4( rgbM, opacity );
+                     return;
+                     
+                 }
+                 
                  vec2 dir;
                  dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
                  dir.y =  ((lumaNW + lumaSW) - (lumaNE + lumaSE));
@@ -76,59 +90,105 @@ namespace itg
                            max( vec2(-FXAA_SPAN_MAX, -FXAA_SPAN_MAX),
                                dir * rcpDirMin)) * resolution;
                  
-                 vec3 rgbA = 0.5 * (
-                                    TEXTURE_FN( tDiffuse, gl_FragCoord.xy  * resolution + dir * ( 1.0 / 3.0 - 0.5 ) ).xyz +
-                                    TEXTURE_FN( tDiffuse, gl_FragCoord.xy  * resolution + dir * ( 2.0 / 3.0 - 0.5 ) ).xyz );
+                 vec4 rgbaA = 0.5 * (
+                                    TEXTURE_FN( tDiffuse, gl_FragCoord.xy  * resolution + dir * ( 1.0 / 3.0 - 0.5 ) ) +
+                                    TEXTURE_FN( tDiffuse, gl_FragCoord.xy  * resolution + dir * ( 2.0 / 3.0 - 0.5 ) ) );
+                 
+                 if ( FXAA_TWO_TAP ) {
+                     
+                     gl_FragColor = vec4( rgbaA.xyz, opacity );
+                     return;
+                     
+                 }
                  
-                 vec3 rgbB = rgbA * 0.5 + 0.25 * (
-                                                  TEXTURE_FN( tDiffuse, gl_FragCoord.xy  * resolution + dir * -0.5 ).xyz +
-                                                  TEXTURE_FN( tDiffuse, gl_FragCoord.xy  * resolution + dir * 0.5 ).xyz );
+                 vec4 rgbaB = rgbaA * 0.5 + 0.25 * (
+                                                  TEXTURE_FN( tDiffuse, gl_FragCoord.xy  * resolution + dir * -0.5 ) +
+                                                  TEXTURE_FN( tDiffuse, gl_FragCoord.xy  * resolution + dir * 0.5 ) );
                  
-                 float lumaB = dot( rgbB, luma );
+                 float lumaB = getLuma( rgbaB );
                  
                  if ( ( lumaB < lumaMin ) || ( lumaB > lumaMax ) ) {
                      
-                     gl_FragColor = vec4( rgbA, opacity );
+                     gl_FragColor = vec4( rgbaA.xyz, opacity );
                      
                  } else {
                      
-                     gl_FragColor = vec4( rgbB, opacity );
+                     gl_FragColor = vec4( rgbaB.xyz, opacity );
                      
                  }
                  
              }
         );
-        ostringstream oss;
-        oss << "#version 120" << endl;
-        if (arb)
-        {
-            oss << "#define SAMPLER_TYPE sampler2DRect" << endl;
-            oss << "#define TEXTURE_FN texture2DRect" << endl;
-            oss << fragShaderSrc;
-        }
-        else
+    }
+    
+    shared_ptr<ofShader> FxaaPass::getProgram(Quality quality, bool lumaInAlpha)
+    {
+        shared_ptr<ofShader>& program = programs[make_pair(quality, lumaInAlpha)];
+        if (!program)
         {
-            oss << "#define SAMPLER_TYPE sampler2D" << endl;
-            oss << "#define TEXTURE_FN texture2D" << endl;
+            ostringstream oss;
+            oss << "#version 120" << endl;
+            if (arb)
+            {
+                oss << "#define SAMPLER_TYPE sampler2DRect" << endl;
+                oss << "#define TEXTURE_FN texture2DRect" << endl;
+            }
+            else
+            {
+                oss << "#define SAMPLER_TYPE sampler2D" << endl;
+                oss << "#define TEXTURE_FN texture2D" << endl;
+            }
+            switch (quality)
+            {
+                case QUALITY_LOW:
+                    oss << "#define SPAN_MAX 4.0" << endl;
+                    oss << "#define REDUCE_MUL (1.0/4.0)" << endl;
+                    oss << "#define EDGE_THRESHOLD (1.0/4.0)" << endl;
+                    oss << "#define EDGE_THRESHOLD_MIN (1.0/12.0)" << endl;
+                    oss << "#define TWO_TAP true" << endl;
+                    break;
+                    
+                case QUALITY_MEDIUM:
+                    oss << "#define SPAN_MAX 8.0" << endl;
+                    oss << "#define REDUCE_MUL (1.0/8.0)" << endl;
+                    oss << "#define EDGE_THRESHOLD (1.0/8.0)" << endl;
+                    oss << "#define EDGE_THRESHOLD_MIN (1.0/16.0)" << endl;
+                    oss << "#define TWO_TAP false" << endl;
+                    break;
+                    
+                default:
+                    oss << "#define SPAN_MAX 8.0" << endl;
+                    oss << "#define REDUCE_MUL (1.0/8.0)" << endl;
+                    oss << "#define EDGE_THRESHOLD 0.0" << endl;
+                    oss << "#define EDGE_THRESHOLD_MIN 0.0" << endl;
+                    oss << "#define TWO_TAP false" << endl;
+                    break;
+            }
+            oss << "#define LUMA_ALPHA " << (lumaInAlpha ? "true" : "false") << endl;
             oss << fragShaderSrc;
+            
+            program = shared_ptr<ofShader>(new ofShader());
+            program->setupShaderFromSource(GL_FRAGMENT_SHADER, oss.str());
+            program->linkProgram();
         }
-        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, oss.str());
-        shader.linkProgram();
+        return program;
     }
     
     void FxaaPass::render(ofFbo& readFbo, ofFbo& writeFbo)
     {
+        shared_ptr<ofShader> shader = getProgram(quality, readLumaFromAlpha);
+        
         writeFbo.begin();
         
-        shader.begin();
+        shader->begin();
         
-        shader.setUniformTexture("tDiffuse", readFbo.getTexture(), 0);
-        if (arb) shader.setUniform2f("resolution", 1.f, 1.f);
-        else shader.setUniform2f("resolution", 1.f / writeFbo.getWidth(), 1.f / writeFbo.getHeight());
+        shader->setUniformTexture("tDiffuse", readFbo.getTexture(), 0);
+        if (arb) shader->setUniform2f("resolution", 1.f, 1.f);
+        else shader->setUniform2f("resolution", 1.f / writeFbo.getWidth(), 1.f / writeFbo.getHeight());
         
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
-        shader.end();
+        shader->end();
         writeFbo.end();
     }
-}
\ No newline at end of file
+}
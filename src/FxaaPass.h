@@ -42,14 +42,36 @@ namespace itg
     {
     public:
         typedef shared_ptr<FxaaPass> Ptr;
+        
+        enum Quality
+        {
+            // shorter search, skips low contrast pixels and only blends the inner two taps
+            QUALITY_LOW,
+            // skips low contrast pixels
+            QUALITY_MEDIUM,
+            // every pixel is filtered
+            QUALITY_HIGH
+        };
     
-        FxaaPass(const ofVec2f& aspect, bool arb);
+        FxaaPass(const ofVec2f& aspect, bool arb, Quality quality = QUALITY_HIGH);
         
         void render(ofFbo& readFbo, ofFbo& writeFbo);
         
         bool hasArbShader() { return true; }
         
+        // when the pass before writes luma into alpha it is read from there
+        // rather than converted from every tap, the output alpha is then 1
+        bool canReadLumaFromAlpha() const { return true; }
+        
+        // each quality is compiled the first time it is used
+        void setQuality(Quality quality) { this->quality = quality; }
+        Quality getQuality() const { return quality; }
+        
     private:
-        ofShader shader;
+        shared_ptr<ofShader> getProgram(Quality quality, bool lumaInAlpha);
+        
+        string fragShaderSrc;
+        map<pair<Quality, bool>, shared_ptr<ofShader> > programs;
+        Quality quality;
     };
 }
\ No newline at end of file
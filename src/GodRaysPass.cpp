@@ -35,8 +35,12 @@
 namespace itg
 {
     GodRaysPass::GodRaysPass(const ofVec2f& aspect, bool arb, const ofVec3f & lightPositionOnScreen, float lightDirDOTviewDir) :
-        lightPositionOnScreen(lightPositionOnScreen), lightDirDOTviewDir(lightDirDOTviewDir), RenderPass(aspect, arb, "godrays")
+        pboIndex(0), visibility(1.f), fade(1.f), strength(lightDirDOTviewDir), updateFrame(~0u), numSkippedFrames(0), mode(MODE_FULL_RES), numSamples(50), RenderPass(aspect, arb, "godrays")
     {
+        Parameters p = { lightPositionOnScreen, lightDirDOTviewDir, 1.f, 1.f, 0.02f, false };
+        parameters.write(p);
+        parameters.latch();
+        guiParameters = latchedGuiParameters = p;
         
         string vertShaderSrc = STRINGIFY(
             void main(void)
@@ -47,69 +51,309 @@ namespace itg
             }
         );
         
-        string fragShaderSrc = STRINGIFY(
-            uniform sampler2D rtex;
-            uniform sampler2D otex;
-
-            const int NUM_SAMPLES = 50;
-
+        // shared by the full res shader and the quarter res march
+        string raysSrc = STRINGIFY(
             uniform vec2 lightPositionOnScreen;
             uniform float lightDirDOTviewDir;
-
+            uniform int numSamples;
+            
+            float rays(sampler2D rtex, vec2 coord)
+            {
+                float exposure	= 0.1/float(numSamples);
+                float decay		= 1.0 ;
+                float density	= 0.5;
+                float weight	= 6.0;
+                float illuminationDecay = 1.0;
+                
+                vec4 raysColor = texture2D(rtex, coord);
+                vec2 deltaTextCoord = vec2( coord - lightPositionOnScreen);
+                vec2 textCoo = coord;
+                deltaTextCoord *= 1.0 / float(numSamples) * density;
+                
+                for(int i=0; i < MAX_SAMPLES ; i++)
+                {
+                    if (i >= numSamples) break;
+                    textCoo -= deltaTextCoord;
+                    vec4 tsample = texture2D(rtex, textCoo );
+                    tsample *= illuminationDecay * weight;
+                    raysColor += tsample;
+                    illuminationDecay *= decay;
+                }
+                raysColor *= exposure * lightDirDOTviewDir;
+                return 0.3 *raysColor.g + 0.59*raysColor.r + 0.11*raysColor.b;
+            }
+        );
+        
+        string fragShaderSrc = STRINGIFY(
+            uniform sampler2D tex;
+            
             void main(void)
             {
-                vec4 origColor = texture2D(otex, gl_TexCoord[0].st);
-                vec4 raysColor = texture2D(rtex, gl_TexCoord[0].st);
-
+                vec4 origColor = texture2D(tex, gl_TexCoord[0].st);
+                
                 if (lightDirDOTviewDir>0.0){
-                    float exposure	= 0.1/float(NUM_SAMPLES);
-                    float decay		= 1.0 ;
-                    float density	= 0.5;
-                    float weight	= 6.0;
-                    float illuminationDecay = 1.0;
-
-                    vec2 deltaTextCoord = vec2( gl_TexCoord[0].st - lightPositionOnScreen);
-                    vec2 textCoo = gl_TexCoord[0].st;
-                    deltaTextCoord *= 1.0 / float(NUM_SAMPLES) * density;
-
-
-
-                    for(int i=0; i < NUM_SAMPLES ; i++)
-                    {
-                        textCoo -= deltaTextCoord;
-                        vec4 tsample = texture2D(rtex, textCoo );
-                        tsample *= illuminationDecay * weight;
-                        raysColor += tsample;
-                        illuminationDecay *= decay;
-                    }
-                    raysColor *= exposure * lightDirDOTviewDir;
-                    float p = 0.3 *raysColor.g + 0.59*raysColor.r + 0.11*raysColor.b;
-                    gl_FragColor = origColor + p;
+                    gl_FragColor = origColor + rays(tex, gl_TexCoord[0].st);
                 } else {
                     gl_FragColor = origColor;
                 }
             }
         );
+        
+        // each texel covers 4x4 of the scene, 4 bilinear taps average it
+        string maskShaderSrc = STRINGIFY(
+            uniform sampler2D tex;
+            uniform sampler2D depthTex;
+            uniform vec2 texel;
+            uniform float skyDepth;
+            
+            vec4 masked(vec2 coord)
+            {
+                return texture2D(tex, coord) * step(skyDepth, texture2D(depthTex, coord).r);
+            }
+            
+            void main(void)
+            {
+                vec2 coord = gl_TexCoord[0].st;
+                gl_FragColor = 0.25 * (masked(coord + texel * vec2(-1.0, -1.0)) +
+                                       masked(coord + texel * vec2( 1.0, -1.0)) +
+                                       masked(coord + texel * vec2(-1.0,  1.0)) +
+                                       masked(coord + texel * vec2( 1.0,  1.0)));
+            }
+        );
+        
+        string marchShaderSrc = STRINGIFY(
+            uniform sampler2D maskTex;
+            
+            void main(void)
+            {
+                float p = 0.0;
+                if (lightDirDOTviewDir>0.0) p = rays(maskTex, gl_TexCoord[0].st);
+                gl_FragColor = vec4(p, p, p, 1.0);
+            }
+        );
+        
+        string compositeShaderSrc = STRINGIFY(
+            uniform sampler2D tex;
+            uniform sampler2D raysTex;
+            
+            void main(void)
+            {
+                gl_FragColor = texture2D(tex, gl_TexCoord[0].st) + texture2D(raysTex, gl_TexCoord[0].st).r;
+            }
+        );
+        
+        // fraction of a 4x4 grid of depth samples around the light that is sky
+        string occlusionShaderSrc = STRINGIFY(
+            uniform sampler2D depthTex;
+            uniform vec2 lightPositionOnScreen;
+            uniform float radius;
+            uniform float skyDepth;
+            
+            void main(void)
+            {
+                float v = 0.0;
+                for (int y = 0; y < 4; ++y)
+                {
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        vec2 coord = lightPositionOnScreen + radius * (vec2(float(x), float(y)) - 1.5) / 1.5;
+                        v += step(skyDepth, texture2D(depthTex, clamp(coord, 0.0, 1.0)).r);
+                    }
+                }
+                gl_FragColor = vec4(v / 16.0);
+            }
+        );
+        
+        ostringstream header;
+        header << "#define MAX_SAMPLES " << MAX_SAMPLES << endl;
+        
         shader.setupShaderFromSource(GL_VERTEX_SHADER, vertShaderSrc);
-        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
+        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, header.str() + raysSrc + fragShaderSrc);
         shader.linkProgram();
         
+        maskShader.setupShaderFromSource(GL_FRAGMENT_SHADER, maskShaderSrc);
+        maskShader.linkProgram();
+        
+        marchShader.setupShaderFromSource(GL_FRAGMENT_SHADER, header.str() + raysSrc + marchShaderSrc);
+        marchShader.linkProgram();
+        
+        compositeShader.setupShaderFromSource(GL_FRAGMENT_SHADER, compositeShaderSrc);
+        compositeShader.linkProgram();
+        
+        occlusionShader.setupShaderFromSource(GL_FRAGMENT_SHADER, occlusionShaderSrc);
+        occlusionShader.linkProgram();
+        
+        pbos[0] = pbos[1] = 0;
+        pboPending[0] = pboPending[1] = false;
+    }
+    
+    GodRaysPass::~GodRaysPass()
+    {
+        if (pbos[0]) glDeleteBuffers(2, pbos);
+    }
+    
+    void GodRaysPass::latchParameters()
+    {
+        // only the fields the gui changed are published so sets from other threads aren't undone
+        const Parameters edited = guiParameters;
+        const Parameters& latched = latchedGuiParameters;
+        if (edited.lightPositionOnScreen != latched.lightPositionOnScreen) setLightPositionOnScreen(edited.lightPositionOnScreen);
+        if (edited.lightDirDOTviewDir != latched.lightDirDOTviewDir) setLightDirDOTviewDir(edited.lightDirDOTviewDir);
+        if (edited.skyDepth != latched.skyDepth) setSkyDepth(edited.skyDepth);
+        if (edited.offScreenMargin != latched.offScreenMargin) setOffScreenMargin(edited.offScreenMargin);
+        if (edited.occlusionRadius != latched.occlusionRadius) setOcclusionRadius(edited.occlusionRadius);
+        if (edited.occlusionTest != latched.occlusionTest) setOcclusionTest(edited.occlusionTest);
+        
+        parameters.latch();
+        guiParameters = latchedGuiParameters = parameters.getReadRef();
+    }
+    
+    void GodRaysPass::update(ofTexture* depth)
+    {
+        // once a frame however many times the chain is processed
+        if (!getEnabled() || updateFrame == ofGetFrameNum()) return;
+        updateFrame = ofGetFrameNum();
+        
+        const Parameters& p = parameters.getReadRef();
+        float target = 1.f;
+        if (p.lightPositionOnScreen.x < -p.offScreenMargin || p.lightPositionOnScreen.x > 1.f + p.offScreenMargin ||
+            p.lightPositionOnScreen.y < -p.offScreenMargin || p.lightPositionOnScreen.y > 1.f + p.offScreenMargin)
+        {
+            target = 0.f;
+        }
+        else if (p.occlusionTest && depth) target = testOcclusion(*depth, p);
+        // 20% of the way each frame at 60fps and the same speed at any other frame rate
+        fade += (target - fade) * (1.f - powf(0.8f, ofGetLastFrameTime() * 60.f));
+        
+        strength = p.lightDirDOTviewDir * fade;
+        if (isIdentity()) ++numSkippedFrames;
     }
     
     void GodRaysPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex)
     {
-        writeFbo.begin();
+        // PostProcessing has already updated, this is for rendering the pass on its own
+        update(&depthTex);
+        if (isIdentity())
+        {
+            beginTarget(writeFbo);
+            readFbo.getTexture().draw(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+            endTarget(writeFbo);
+            return;
+        }
+        
+        const Parameters& p = parameters.getReadRef();
+        if (mode == MODE_QUARTER_RES)
+        {
+            renderQuarterRes(readFbo, writeFbo, depthTex, strength);
+            return;
+        }
+        
+        beginTarget(writeFbo);
         
         shader.begin();
-        shader.setUniformTexture("otex", readFbo.getTexture(), 0);
-        shader.setUniformTexture("rtex", readFbo.getTexture(), 1);
-        shader.setUniform2f("lightPositionOnScreen", lightPositionOnScreen.x, lightPositionOnScreen.y);
-        shader.setUniform1f("lightDirDOTviewDir", lightDirDOTviewDir);
+        shader.setUniformTexture("tex", readFbo.getTexture(), 0);
+        shader.setUniform2f("lightPositionOnScreen", p.lightPositionOnScreen.x, p.lightPositionOnScreen.y);
+        shader.setUniform1f("lightDirDOTviewDir", strength);
+        shader.setUniform1i("numSamples", numSamples);
         
         
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
+    }
+    
+    void GodRaysPass::renderQuarterRes(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex, float strength)
+    {
+        const Parameters& p = parameters.getReadRef();
+        unsigned w = max(1.f, readFbo.getWidth() / 4.f);
+        unsigned h = max(1.f, readFbo.getHeight() / 4.f);
+        if (!maskFbo.isAllocated() || maskFbo.getWidth() != w || maskFbo.getHeight() != h)
+        {
+            // sampled with 0-1 coordinates whatever openFrameworks' arb default is
+            ofFbo::Settings s;
+            s.width = w;
+            s.height = h;
+            s.textureTarget = GL_TEXTURE_2D;
+            maskFbo.allocate(s);
+            s.internalformat = GL_RGBA16F;
+            raysFbo.allocate(s);
+        }
+        
+        maskFbo.begin();
+        maskShader.begin();
+        maskShader.setUniformTexture("tex", readFbo.getTexture(), 0);
+        maskShader.setUniformTexture("depthTex", depthTex, 1);
+        maskShader.setUniform2f("texel", 1.f / readFbo.getWidth(), 1.f / readFbo.getHeight());
+        maskShader.setUniform1f("skyDepth", p.skyDepth);
+        texturedQuad(0, 0, w, h);
+        maskShader.end();
+        maskFbo.end();
+        
+        raysFbo.begin();
+        marchShader.begin();
+        marchShader.setUniformTexture("maskTex", maskFbo.getTexture(), 0);
+        marchShader.setUniform2f("lightPositionOnScreen", p.lightPositionOnScreen.x, p.lightPositionOnScreen.y);
+        marchShader.setUniform1f("lightDirDOTviewDir", strength);
+        marchShader.setUniform1i("numSamples", numSamples);
+        texturedQuad(0, 0, w, h);
+        marchShader.end();
+        raysFbo.end();
+        
+        beginTarget(writeFbo);
+        compositeShader.begin();
+        compositeShader.setUniformTexture("tex", readFbo.getTexture(), 0);
+        compositeShader.setUniformTexture("raysTex", raysFbo.getTexture(), 1);
+        texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+        compositeShader.end();
+        endTarget(writeFbo);
+    }
+    
+    float GodRaysPass::testOcclusion(ofTexture& depthTex, const Parameters& p)
+    {
+        if (!pbos[0])
+        {
+            ofFbo::Settings s;
+            s.width = 1;
+            s.height = 1;
+            s.textureTarget = GL_TEXTURE_2D;
+            occlusionFbo.allocate(s);
+            glGenBuffers(2, pbos);
+            for (unsigned i = 0; i < 2; ++i)
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+                glBufferData(GL_PIXEL_PACK_BUFFER, 4, NULL, GL_STREAM_READ);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        
+        // the other buffer was filled last frame so mapping it shouldn't wait on the gpu
+        unsigned readIndex = 1 - pboIndex;
+        if (pboPending[readIndex])
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[readIndex]);
+            unsigned char* pixel = (unsigned char*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+            if (pixel) visibility = pixel[0] / 255.f;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            pboPending[readIndex] = false;
+        }
+        
+        occlusionFbo.begin();
+        occlusionShader.begin();
+        occlusionShader.setUniformTexture("depthTex", depthTex, 0);
+        occlusionShader.setUniform2f("lightPositionOnScreen", p.lightPositionOnScreen.x, p.lightPositionOnScreen.y);
+        occlusionShader.setUniform1f("radius", p.occlusionRadius);
+        occlusionShader.setUniform1f("skyDepth", p.skyDepth);
+        texturedQuad(0, 0, 1, 1);
+        occlusionShader.end();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[pboIndex]);
+        glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        occlusionFbo.end();
+        pboPending[pboIndex] = true;
+        pboIndex = readIndex;
+        
+        return visibility;
     }
-}
\ No newline at end of file
+}
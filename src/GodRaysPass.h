@@ -33,6 +33,7 @@
 
 #include "RenderPass.h"
 #include "ofShader.h"
+#include "TripleBuffer.h"
 
 namespace itg
 {
@@ -42,20 +43,114 @@ namespace itg
         //http://code.google.com/p/natureal/source/browse/trunk/PGR2project/shaders/godrays/godrays_fs.glsl?r=18
         typedef shared_ptr<GodRaysPass> Ptr;
         
+        enum Mode
+        {
+            // march the scene at full resolution
+            MODE_FULL_RES,
+            // march a depth masked copy of the scene at a quarter of the resolution
+            // so only the sky and the light contribute, then upsample the rays
+            MODE_QUARTER_RES
+        };
+        
+        static const unsigned MAX_SAMPLES = 128;
+        
+        struct Parameters
+        {
+            ofVec3f lightPositionOnScreen;
+            float lightDirDOTviewDir;
+            float skyDepth;
+            float offScreenMargin;
+            float occlusionRadius;
+            bool occlusionTest;
+        };
+        
         GodRaysPass(const ofVec2f& aspect, bool arb, const ofVec3f & lightPositionOnScreen = ofVec3f(0.5,0.5,0.5), float lightDirDOTviewDir = 0.3 );
+        ~GodRaysPass();
         
         void render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth);
         
-        void setLightPositionOnScreen(const ofVec3f & val) { lightPositionOnScreen = val; }
-        const ofVec3f getlightPositionOnScreen() { return lightPositionOnScreen; }
+        // the occlusion test reads depth even when the rays have faded out
+        bool usesDepth() const { return parameters.getReadRef().occlusionTest || !isIdentity(); }
+        
+        // fades the rays in and out, the pass is skipped while they're faded out
+        void update(ofTexture* depth);
+        bool isIdentity() const { return strength <= 0.001f; }
+        
+        // getters and setters of Parameters can be called from any thread, set
+        // values are used from the next PostProcessing::begin(). The Ref getters
+        // edit a render thread copy for a gui, see DofAltPass.
+        void setLightPositionOnScreen(const ofVec3f & val) { parameters.modify([val](Parameters& p) { p.lightPositionOnScreen = val; }); }
+        const ofVec3f getlightPositionOnScreen() { return parameters.getLatest().lightPositionOnScreen; }
+        
+        void setLightDirDOTviewDir(float val) { parameters.modify([val](Parameters& p) { p.lightDirDOTviewDir = val; }); }
+        float getLightDirDOTviewDir() { return parameters.getLatest().lightDirDOTviewDir; }
+        
+        void setMode(Mode mode) { this->mode = mode; }
+        Mode getMode() const { return mode; }
+        
+        // samples along each ray, up to MAX_SAMPLES
+        void setNumSamples(unsigned numSamples) { this->numSamples = max(1u, min(numSamples, (unsigned)MAX_SAMPLES)); }
+        unsigned getNumSamples() const { return numSamples; }
+        
+        // in quarter res mode pixels with a depth of at least this contribute,
+        // the default only lets through where nothing was drawn so draw the
+        // light without writing depth
+        void setSkyDepth(float skyDepth) { parameters.modify([skyDepth](Parameters& p) { p.skyDepth = skyDepth; }); }
+        float getSkyDepth() const { return parameters.getLatest().skyDepth; }
+        float& getSkyDepthRef() { return guiParameters.skyDepth; }
+        
+        // rays fade out when the light is further than this outside the screen (in texture coordinates)
+        void setOffScreenMargin(float offScreenMargin) { parameters.modify([offScreenMargin](Parameters& p) { p.offScreenMargin = offScreenMargin; }); }
+        float getOffScreenMargin() const { return parameters.getLatest().offScreenMargin; }
+        
+        // fade the rays by how much of the area around the light is sky (see setSkyDepth), the
+        // test runs on the gpu and is read back a frame late so it doesn't stall
+        void setOcclusionTest(bool occlusionTest) { parameters.modify([occlusionTest](Parameters& p) { p.occlusionTest = occlusionTest; }); }
+        bool getOcclusionTest() const { return parameters.getLatest().occlusionTest; }
+        bool& getOcclusionTestRef() { return guiParameters.occlusionTest; }
+        
+        // radius of the occlusion test around the light in texture coordinates
+        void setOcclusionRadius(float occlusionRadius) { parameters.modify([occlusionRadius](Parameters& p) { p.occlusionRadius = occlusionRadius; }); }
+        float getOcclusionRadius() const { return parameters.getLatest().occlusionRadius; }
+        
+        void setParameters(const Parameters& parameters) { this->parameters.write(parameters); }
+        Parameters getLatestParameters() const { return parameters.getLatest(); }
+        void latchParameters();
+        
+        // frames where the rays had faded out and the pass was skipped
+        unsigned getNumSkippedFrames() const { return numSkippedFrames; }
         
-        void setLightDirDOTviewDir(float val) { lightDirDOTviewDir = val; }
-        float getLightDirDOTviewDir() { return lightDirDOTviewDir; }
     private:
+        void renderQuarterRes(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex, float strength);
+        
+        // returns the visibility read back from the previous frame's test
+        float testOcclusion(ofTexture& depthTex, const Parameters& p);
         
         ofShader shader;
+        ofShader maskShader;
+        ofShader marchShader;
+        ofShader compositeShader;
+        ofShader occlusionShader;
+        
+        ofFbo maskFbo;
+        ofFbo raysFbo;
+        ofFbo occlusionFbo;
+        
+        GLuint pbos[2];
+        unsigned pboIndex;
+        bool pboPending[2];
+        float visibility;
+        float fade;
+        float strength;
+        unsigned updateFrame;
+        unsigned numSkippedFrames;
+        
+        Mode mode;
+        unsigned numSamples;
         
-        ofVec3f lightPositionOnScreen;
-        float lightDirDOTviewDir;
+        TripleBuffer<Parameters> parameters;
+        // render thread only, what the Ref getters edit and what they held after the last latch
+        Parameters guiParameters;
+        Parameters latchedGuiParameters;
     };
 }
\ No newline at end of file
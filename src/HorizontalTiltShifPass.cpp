@@ -71,7 +71,7 @@ namespace itg
     
     void HorizontalTiltShifPass::render(ofFbo& readFbo, ofFbo& writeFbo)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         shader.begin();
         shader.setUniformTexture("tDiffuse", readFbo.getTexture(), 0);
@@ -81,6 +81,6 @@ namespace itg
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
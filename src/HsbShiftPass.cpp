@@ -61,25 +61,27 @@ namespace itg
                 vec3 hsb = rgbToHsb(texture2D(tex, gl_TexCoord[0].st).rgb);
                 vec3 rgb = hsbToRgb(vec3(hsb.x + hueShift, hsb.y + saturationShift, hsb.z + brightnessShift));
                 gl_FragColor = vec4(rgb, 1.0);
+                gl_FragColor = applyLumaToAlpha(gl_FragColor);
             }
         );
         
-        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
+        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, getLumaToAlphaSrc() + fragShaderSrc);
         shader.linkProgram();
     }
     
     void HsbShiftPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         shader.begin();
         shader.setUniformTexture("tex", readFbo.getTexture(), 0);
         shader.setUniform1f("hueShift", hueShift);
         shader.setUniform1f("saturationShift", saturationShift);
         shader.setUniform1f("brightnessShift", brightnessShift);
+        shader.setUniform1i("lumaToAlpha", writeLumaToAlpha ? 1 : 0);
         
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
\ No newline at end of file
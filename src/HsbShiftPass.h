@@ -52,6 +52,17 @@ namespace itg
         
         float getBrightnessShift() const { return brightnessShift; }
         void setSpeed(float brightnessShift) { this->brightnessShift = brightnessShift; }
+
+        bool canWriteLumaToAlpha() const { return true; }
+        
+        bool isColorMapping() const { return true; }
+        bool isIdentity() const { return hueShift == 0.f && saturationShift == 0.f && brightnessShift == 0.f; }
+        void getParameters(vector<float>& parameters) const
+        {
+            parameters.push_back(hueShift);
+            parameters.push_back(saturationShift);
+            parameters.push_back(brightnessShift);
+        }
         
     private:
         ofShader shader;
@@ -63,7 +63,7 @@ namespace itg
     
     void KaleidoscopePass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         shader.begin();
         
@@ -73,6 +73,6 @@ namespace itg
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
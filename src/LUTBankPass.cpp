@@ -0,0 +1,297 @@
+/*
+ *  LUTBankPass.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "LUTBankPass.h"
+
+namespace itg
+{
+    LUTBankPass::LUTBankPass(const ofVec2f& aspect, bool arb, unsigned size, Format format) :
+        tex(0), version(0), size(max(size, 2u)), format(format), RenderPass(aspect, arb, "lutbank")
+    {
+        Parameters p = { 0, 0, 0.f, false };
+        parameters.write(p);
+        parameters.latch();
+        guiParameters = latchedGuiParameters = p;
+        
+        string fragShaderSrc = STRINGIFY(
+            uniform sampler2D tex;
+            uniform sampler3D bank;
+            uniform float size;
+            uniform float numLUTs;
+            uniform float from;
+            uniform float to;
+            uniform float amount;
+            uniform vec3 fromDomainMin;
+            uniform vec3 fromDomainScale;
+            uniform vec3 toDomainMin;
+            uniform vec3 toDomainScale;
+            uniform bool tetrahedral;
+            
+            // p is in texels of one entry, entries are stacked along z so
+            // keeping z within an entry's texel centres stops filtering
+            // from reaching the next one
+            vec3 fetch(vec3 p, float index)
+            {
+                return texture3D(bank, vec3((p.xy + 0.5) / size, (index * size + p.z + 0.5) / (size * numLUTs))).rgb;
+            }
+            
+            vec3 lookup(vec3 c, float index, vec3 domainMin, vec3 domainScale)
+            {
+                vec3 p = clamp((c - domainMin) * domainScale, 0.0, 1.0) * (size - 1.0);
+                if (!tetrahedral) return fetch(p, index);
+                
+                vec3 base = min(floor(p), size - 2.0);
+                vec3 f = p - base;
+                vec3 c000 = fetch(base, index);
+                vec3 c111 = fetch(base + 1.0, index);
+                if (f.r > f.g)
+                {
+                    if (f.g > f.b) return (1.0 - f.r) * c000 + (f.r - f.g) * fetch(base + vec3(1.0, 0.0, 0.0), index) + (f.g - f.b) * fetch(base + vec3(1.0, 1.0, 0.0), index) + f.b * c111;
+                    if (f.r > f.b) return (1.0 - f.r) * c000 + (f.r - f.b) * fetch(base + vec3(1.0, 0.0, 0.0), index) + (f.b - f.g) * fetch(base + vec3(1.0, 0.0, 1.0), index) + f.g * c111;
+                    return (1.0 - f.b) * c000 + (f.b - f.r) * fetch(base + vec3(0.0, 0.0, 1.0), index) + (f.r - f.g) * fetch(base + vec3(1.0, 0.0, 1.0), index) + f.g * c111;
+                }
+                if (f.b > f.g) return (1.0 - f.b) * c000 + (f.b - f.g) * fetch(base + vec3(0.0, 0.0, 1.0), index) + (f.g - f.r) * fetch(base + vec3(0.0, 1.0, 1.0), index) + f.r * c111;
+                if (f.b > f.r) return (1.0 - f.g) * c000 + (f.g - f.b) * fetch(base + vec3(0.0, 1.0, 0.0), index) + (f.b - f.r) * fetch(base + vec3(0.0, 1.0, 1.0), index) + f.r * c111;
+                return (1.0 - f.g) * c000 + (f.g - f.r) * fetch(base + vec3(0.0, 1.0, 0.0), index) + (f.r - f.b) * fetch(base + vec3(1.0, 1.0, 0.0), index) + f.b * c111;
+            }
+            
+            void main()
+            {
+                vec4 c = texture2D(tex, gl_TexCoord[0].xy);
+                vec3 result = lookup(c.rgb, from, fromDomainMin, fromDomainScale);
+                if (amount > 0.0) result = mix(result, lookup(c.rgb, to, toDomainMin, toDomainScale), amount);
+                gl_FragColor = vec4(result, c.a);
+                gl_FragColor = applyLumaToAlpha(gl_FragColor);
+            }
+        );
+        
+        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, getLumaToAlphaSrc() + fragShaderSrc);
+        shader.linkProgram();
+    }
+    
+    LUTBankPass::~LUTBankPass()
+    {
+        if (tex) glDeleteTextures(1, &tex);
+    }
+    
+    int LUTBankPass::addLUT(const string& path, bool useCache)
+    {
+        CubeLUT cube;
+        if (!cube.load(path, useCache)) return -1;
+        return addLUT(cube);
+    }
+    
+    int LUTBankPass::addLUT(const CubeLUT& cube)
+    {
+        if (!cube.isLoaded()) return -1;
+        
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+        if (maxSize > 0 && (entries.size() + 1) * size > (unsigned)maxSize)
+        {
+            ofLogError() << "LUT bank is full, " << maxSize / size << " LUTs of size " << size << " fit in a 3D texture.";
+            return -1;
+        }
+        
+        Entry entry;
+        entry.title = cube.getTitle();
+        entry.domainMin = cube.getDomainMin();
+        entry.domainMax = cube.getDomainMax();
+        
+        const int srcSize = cube.getSize();
+        const vector<float>& src = cube.getData();
+        if (srcSize == (int)size) entry.data = src;
+        else
+        {
+            // resample with trilinear filtering, the first and last entries of each axis stay put
+            entry.data.resize(3 * size * size * size);
+            float* out = &entry.data[0];
+            const float scale = (srcSize - 1.f) / (size - 1.f);
+            for (unsigned z = 0; z < size; ++z)
+            {
+                for (unsigned y = 0; y < size; ++y)
+                {
+                    for (unsigned x = 0; x < size; ++x)
+                    {
+                        float p[3] = { x * scale, y * scale, z * scale };
+                        int i[3];
+                        float f[3];
+                        for (unsigned k = 0; k < 3; ++k)
+                        {
+                            i[k] = min((int)p[k], srcSize - 2);
+                            f[k] = p[k] - i[k];
+                        }
+                        for (unsigned c = 0; c < 3; ++c)
+                        {
+                            float value = 0.f;
+                            for (unsigned corner = 0; corner < 8; ++corner)
+                            {
+                                unsigned dx = corner & 1, dy = (corner >> 1) & 1, dz = corner >> 2;
+                                float weight = (dx ? f[0] : 1.f - f[0]) * (dy ? f[1] : 1.f - f[1]) * (dz ? f[2] : 1.f - f[2]);
+                                value += weight * src[3 * (((i[2] + dz) * srcSize + i[1] + dy) * srcSize + i[0] + dx) + c];
+                            }
+                            *out++ = value;
+                        }
+                    }
+                }
+            }
+        }
+        
+        entries.push_back(entry);
+        upload();
+        return entries.size() - 1;
+    }
+    
+    void LUTBankPass::clear()
+    {
+        entries.clear();
+        if (tex) glDeleteTextures(1, &tex);
+        tex = 0;
+        ++version;
+        setCrossfade(0, 0, 0.f);
+    }
+    
+    void LUTBankPass::setLUT(unsigned index)
+    {
+        setCrossfade(index, index, 0.f);
+    }
+    
+    void LUTBankPass::setCrossfade(unsigned from, unsigned to, float amount)
+    {
+        amount = ofClamp(amount, 0.f, 1.f);
+        parameters.modify([from, to, amount](Parameters& p)
+        {
+            p.from = from;
+            p.to = to;
+            p.amount = amount;
+        });
+    }
+    
+    void LUTBankPass::latchParameters()
+    {
+        // only the fields the gui changed are published so sets from other threads aren't undone
+        const Parameters edited = guiParameters;
+        const Parameters& latched = latchedGuiParameters;
+        if (edited.amount != latched.amount)
+        {
+            const float amount = ofClamp(edited.amount, 0.f, 1.f);
+            parameters.modify([amount](Parameters& p) { p.amount = amount; });
+        }
+        
+        parameters.latch();
+        guiParameters = latchedGuiParameters = parameters.getReadRef();
+    }
+    
+    size_t LUTBankPass::getMemoryUsage() const
+    {
+        const size_t bytesPerTexel = format == FORMAT_RGBA16F ? 8 : 4;
+        return bytesPerTexel * size * size * size * entries.size();
+    }
+    
+    void LUTBankPass::upload()
+    {
+        // the whole bank is reallocated when an entry is added, adding is rare and this keeps it one texture
+        if (!tex) glGenTextures(1, &tex);
+        
+        glEnable(GL_TEXTURE_3D);
+        glBindTexture(GL_TEXTURE_3D, tex);
+        
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        
+        GLint internalFormat = format == FORMAT_RGBA16F ? GL_RGBA16F : GL_RGB10_A2;
+        glTexImage3D(GL_TEXTURE_3D, 0, internalFormat, size, size, size * entries.size(), 0, GL_RGB, GL_FLOAT, NULL);
+        for (unsigned i = 0; i < entries.size(); ++i)
+        {
+            glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, i * size, size, size, size, GL_RGB, GL_FLOAT, &entries[i].data[0]);
+        }
+        
+        glBindTexture(GL_TEXTURE_3D, 0);
+        
+        glDisable(GL_TEXTURE_3D);
+        
+        ++version;
+    }
+    
+    void LUTBankPass::setDomainUniforms(const string& name, const Entry& entry)
+    {
+        shader.setUniform3f(name + "DomainMin", entry.domainMin.x, entry.domainMin.y, entry.domainMin.z);
+        shader.setUniform3f(name + "DomainScale",
+                            1.f / (entry.domainMax.x - entry.domainMin.x),
+                            1.f / (entry.domainMax.y - entry.domainMin.y),
+                            1.f / (entry.domainMax.z - entry.domainMin.z));
+    }
+    
+    void LUTBankPass::render(ofFbo& readFbo, ofFbo& writeFbo)
+    {
+        if (entries.empty())
+        {
+            beginTarget(writeFbo);
+            readFbo.getTexture().draw(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+            endTarget(writeFbo);
+            return;
+        }
+        
+        const Parameters& p = parameters.getReadRef();
+        const unsigned last = entries.size() - 1;
+        // at either end of a crossfade only one entry is looked up
+        const unsigned toIndex = min(p.to, last);
+        const unsigned fromIndex = p.amount >= 1.f ? toIndex : min(p.from, last);
+        
+        beginTarget(writeFbo);
+        
+        shader.begin();
+        
+        shader.setUniformTexture("tex", readFbo.getTexture(), 0);
+        shader.setUniformTexture("bank", GL_TEXTURE_3D, tex, 1);
+        shader.setUniform1f("size", size);
+        shader.setUniform1f("numLUTs", entries.size());
+        shader.setUniform1f("from", fromIndex);
+        shader.setUniform1f("to", toIndex);
+        shader.setUniform1f("amount", fromIndex == toIndex ? 0.f : p.amount);
+        setDomainUniforms("from", entries[fromIndex]);
+        setDomainUniforms("to", entries[toIndex]);
+        shader.setUniform1i("tetrahedral", p.tetrahedral ? 1 : 0);
+        shader.setUniform1i("lumaToAlpha", writeLumaToAlpha ? 1 : 0);
+        
+        texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+        
+        shader.end();
+        
+        endTarget(writeFbo);
+    }
+}
@@ -0,0 +1,149 @@
+/*
+ *  LUTBankPass.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "RenderPass.h"
+#include "CubeLUT.h"
+#include "ofShader.h"
+#include "TripleBuffer.h"
+
+namespace itg
+{
+    /*
+     * Keeps several LUTs on the gpu at once so grades can be switched or
+     * crossfaded without reloading. The LUTs are resampled to one size and
+     * stacked along z in a single 3D texture. Each frame blends any two of
+     * them in one pass.
+     */
+    class LUTBankPass : public RenderPass
+    {
+    public:
+        typedef shared_ptr<LUTBankPass> Ptr;
+        
+        enum Format
+        {
+            // 8 bytes a texel, keeps values outside 0-1
+            FORMAT_RGBA16F,
+            // 4 bytes a texel, output is clamped to 0-1
+            FORMAT_RGB10_A2
+        };
+        
+        struct Parameters
+        {
+            unsigned from;
+            unsigned to;
+            float amount;
+            bool tetrahedral;
+        };
+        
+        LUTBankPass(const ofVec2f& aspect, bool arb, unsigned size = 33, Format format = FORMAT_RGBA16F);
+        ~LUTBankPass();
+        
+        // returns the index of the new entry or -1 if it couldn't be loaded
+        int addLUT(const string& path, bool useCache = true);
+        int addLUT(const CubeLUT& cube);
+        void clear();
+        
+        unsigned getNumLUTs() const { return entries.size(); }
+        const string& getTitle(unsigned index) const { return entries[index].title; }
+        
+        // the selection can be set from any thread and is used from the next
+        // PostProcessing::begin(), loading and clearing are render thread only.
+        // The Ref getter edits a render thread copy for a gui, see DofAltPass.
+        
+        // shows one entry
+        void setLUT(unsigned index);
+        
+        // blends from one entry to another, amount 0 is all from and 1 is all to
+        void setCrossfade(unsigned from, unsigned to, float amount);
+        
+        unsigned getFrom() const { return parameters.getLatest().from; }
+        unsigned getTo() const { return parameters.getLatest().to; }
+        float getAmount() const { return parameters.getLatest().amount; }
+        float& getAmountRef() { return guiParameters.amount; }
+        
+        // four texel fetches rather than trilinear filtering, closer to how most grading tools sample
+        bool getTetrahedral() const { return parameters.getLatest().tetrahedral; }
+        void setTetrahedral(bool tetrahedral) { parameters.modify([tetrahedral](Parameters& p) { p.tetrahedral = tetrahedral; }); }
+        
+        void setParameters(const Parameters& parameters) { this->parameters.write(parameters); }
+        Parameters getLatestParameters() const { return parameters.getLatest(); }
+        void latchParameters();
+        
+        unsigned getSize() const { return size; }
+        Format getFormat() const { return format; }
+        
+        // bytes of gpu memory used by the bank
+        size_t getMemoryUsage() const;
+        
+        void render(ofFbo& readFbo, ofFbo& writeFbo);
+        
+        bool canWriteLumaToAlpha() const { return true; }
+        
+        bool isColorMapping() const { return true; }
+        bool isIdentity() const { return entries.empty(); }
+        void getParameters(vector<float>& parameters) const
+        {
+            const Parameters& p = this->parameters.getReadRef();
+            parameters.push_back(p.from);
+            parameters.push_back(p.to);
+            parameters.push_back(p.amount);
+            parameters.push_back(p.tetrahedral);
+            parameters.push_back(version);
+        }
+        
+    private:
+        struct Entry
+        {
+            string title;
+            vector<float> data;
+            ofVec3f domainMin;
+            ofVec3f domainMax;
+        };
+        
+        void upload();
+        void setDomainUniforms(const string& name, const Entry& entry);
+        
+        vector<Entry> entries;
+        ofShader shader;
+        GLuint tex;
+        // changes whenever the contents of the bank do
+        unsigned version;
+        unsigned size;
+        Format format;
+        
+        TripleBuffer<Parameters> parameters;
+        // render thread only, what the Ref getter edits and what it held after the last latch
+        Parameters guiParameters;
+        Parameters latchedGuiParameters;
+    };
+}
@@ -30,145 +30,274 @@
  *
  */
 #include "LUTPass.h"
+#include <thread>
 
 namespace itg
 {
 
-    LUTPass::LUTPass(const ofVec2f& aspect, bool arb) : RenderPass(aspect, arb, "lut"), lut_tex(0)
+    LUTPass::LUTPass(const ofVec2f& aspect, bool arb) :
+        RenderPass(aspect, arb, "lut"), lut_tex(0), lutVersion(0), updateFrame(~0u), copyOffset(0), mappedPbo(NULL), uploadTex(0), pbo(0), lastParseTime(0.f), lastLoadTime(0.f)
     {
     }
 
     LUTPass::~LUTPass()
     {
         dispose();
+        if (pbo) glDeleteBuffers(1, &pbo);
     }
 
-    struct RGB
-    {
-        float r, g, b;
-    };
-
-    LUTPass* LUTPass::loadLUT(string path)
+    LUTPass* LUTPass::loadLUT(string path, bool useCache)
     {
         dispose();
 
-        vector<RGB> lut;
-        int LUT_3D_SIZE = 0;
+        uint64_t startTime = ofGetElapsedTimeMicros();
+        if (!cube.load(path, useCache)) return this;
+        lastParseTime = lastLoadTime = (ofGetElapsedTimeMicros() - startTime) / 1000.f;
 
-        // load .cube file
-        {
-            path = ofToDataPath(path);
+        lut_tex = createTexture(cube, false);
+        ++lutVersion;
+        setupShader();
 
-            ifstream ifs(path.c_str());
+        return this;
+    }
 
-            while (!ifs.eof())
-            {
-                string line;
-                getline(ifs, line);
+    shared_future<bool> LUTPass::loadLUTAsync(string path, bool useCache)
+    {
+        // a newer request replaces one that hasn't been uploaded yet
+        if (pending) pending->done.set_value(false);
+
+        pending = make_shared<AsyncLoad>();
+        pending->path = path;
+        pending->useCache = useCache;
+        pending->startTime = ofGetElapsedTimeMicros();
+        pendingParsed = pending->parsed.get_future();
+        shared_future<bool> done = pending->done.get_future().share();
+
+        // the worker only touches the load it was given so it can outlive a superseded request or the pass
+        shared_ptr<AsyncLoad> load = pending;
+        thread([load]()
+               {
+                   uint64_t startTime = ofGetElapsedTimeMicros();
+                   bool loaded = load->cube.load(load->path, load->useCache);
+                   load->parseTime = (ofGetElapsedTimeMicros() - startTime) / 1000.f;
+                   load->parsed.set_value(loaded);
+               }).detach();
+
+        return done;
+    }
 
-                if (line.empty()) continue;
+    bool LUTPass::isLoading() const
+    {
+        return pending || copying || uploading;
+    }
 
-                int v;
-                if (sscanf(line.c_str(), "LUT_3D_SIZE %i", &v) == 1)
-                {
-                    LUT_3D_SIZE = v;
-                    break;
-                }
-            }
+    void LUTPass::updateAsyncLoad()
+    {
+        // the texture uploaded last frame has had a frame to reach the gpu so it replaces the current one now
+        if (uploading)
+        {
+            if (lut_tex) glDeleteTextures(1, &lut_tex);
+            lut_tex = uploadTex;
+            ++lutVersion;
+            uploadTex = 0;
+            swap(cube, uploading->cube);
+            lastLoadTime = (ofGetElapsedTimeMicros() - uploading->startTime) / 1000.f;
+            uploading->done.set_value(true);
+            uploading.reset();
+        }
 
-            if (LUT_3D_SIZE == 0)
+        // a whole 65^3 lut is 3mb so it goes into the pbo over a few frames, the
+        // frame after the last chunk only unmaps it and starts the upload
+        if (copying)
+        {
+            const vector<float>& data = copying->cube.getData();
+            const size_t numBytes = data.size() * sizeof(float);
+            if (copyOffset == numBytes)
             {
-                LUT_3D_SIZE = 32;
+                uploadTex = createTexture(copying->cube, true);
+                setupShader();
+                uploading = copying;
+                copying.reset();
             }
-
-            while (!ifs.eof())
+            else
             {
-                string line;
-                getline(ifs, line);
-
-                if (line.empty()) continue;
-
-                RGB v;
-                if (sscanf(line.c_str(), "%f %f %f", &v.r, &v.g, &v.b) == 3)
+                size_t n = min((size_t)COPY_CHUNK_SIZE, numBytes - copyOffset);
+                memcpy(mappedPbo + copyOffset, (const char*)&data[0] + copyOffset, n);
+                copyOffset += n;
+            }
+        }
+        // a newer load waits for the copy as there's one pbo
+        else if (pending && pendingParsed.wait_for(chrono::seconds(0)) == future_status::ready)
+        {
+            if (pendingParsed.get())
+            {
+                lastParseTime = pending->parseTime;
+                if (mapPbo(pending->cube.getData().size() * sizeof(float)))
+                {
+                    copying = pending;
+                    copyOffset = 0;
+                }
+                else
                 {
-                    lut.push_back(v);
+                    uploadTex = createTexture(pending->cube, false);
+                    setupShader();
+                    uploading = pending;
                 }
             }
-
-			if (lut.size() != (LUT_3D_SIZE * LUT_3D_SIZE * LUT_3D_SIZE)) ofLogError() << "LUT size is incorrect.";
+            else pending->done.set_value(false);
+            pending.reset();
         }
+    }
 
-        // gen texture
-        {
-            glGenTextures(1, &lut_tex);
+    bool LUTPass::mapPbo(size_t numBytes)
+    {
+        if (!pbo) glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, numBytes, NULL, GL_STREAM_DRAW);
+        // stays mapped across frames, nothing else uses the buffer until it's unmapped
+        mappedPbo = (char*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return mappedPbo != NULL;
+    }
 
-            glEnable(GL_TEXTURE_3D);
-            glBindTexture(GL_TEXTURE_3D, lut_tex);
+    void LUTPass::cancelAsyncLoad()
+    {
+        if (pending)
+        {
+            pending->done.set_value(false);
+            pending.reset();
+        }
+        if (copying)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            mappedPbo = NULL;
+            copying->done.set_value(false);
+            copying.reset();
+        }
+        if (uploading)
+        {
+            glDeleteTextures(1, &uploadTex);
+            uploadTex = 0;
+            uploading->done.set_value(false);
+            uploading.reset();
+        }
+    }
 
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    GLuint LUTPass::createTexture(const CubeLUT& cube, bool usePbo)
+    {
+        GLuint tex;
+        glGenTextures(1, &tex);
 
-            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glEnable(GL_TEXTURE_3D);
+        glBindTexture(GL_TEXTURE_3D, tex);
 
-            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-            glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-            glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB, LUT_3D_SIZE, LUT_3D_SIZE, LUT_3D_SIZE, 0, GL_RGB, GL_FLOAT, &lut[0]);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
 
-            glBindTexture(GL_TEXTURE_3D, 0);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
-            glDisable(GL_TEXTURE_3D);
+        const int size = cube.getSize();
+        const float* data = &cube.getData()[0];
+        if (usePbo)
+        {
+            // uploading from a pbo lets the driver do the transfer itself instead of glTexImage3D blocking on it
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+            mappedPbo = NULL;
+            // false means the contents were lost while mapped, e.g. a mode switch, so upload from memory
+            if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) data = NULL;
+            else
+            {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                usePbo = false;
+            }
         }
 
-        // setup shader
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB, size, size, size, 0, GL_RGB, GL_FLOAT, data);
+
+        if (usePbo) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        glBindTexture(GL_TEXTURE_3D, 0);
+
+        glDisable(GL_TEXTURE_3D);
+
+        return tex;
+    }
+
+    void LUTPass::setupShader()
+    {
+        if (shader.isLoaded()) return;
+
         string fragShaderSrc = STRINGIFY(
             uniform sampler2D tex;
             uniform sampler3D lut_tex;
+            uniform vec3 domainMin;
+            uniform vec3 domainScale;
 
             void main()
             {
                 vec4 c = texture2D(tex, gl_TexCoord[0].xy);
-                vec3 src = c.rgb;
+                vec3 src = (c.rgb - domainMin) * domainScale;
                 src = clamp(src, 0., 0.98);
                 vec3 dst = texture3D(lut_tex, src).rgb;
                 gl_FragColor = gl_Color * vec4(dst, c.a);
+                gl_FragColor = applyLumaToAlpha(gl_FragColor);
             }
         );
 
-        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
+        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, getLumaToAlphaSrc() + fragShaderSrc);
         shader.linkProgram();
-
-        return this;
     }
 
     void LUTPass::dispose()
     {
+        cancelAsyncLoad();
         if (lut_tex)
         {
             glDeleteTextures(1, &lut_tex);
-            lut_tex = NULL;
-
-            shader.unload();
+            lut_tex = 0;
+            ++lutVersion;
+            cube.clear();
         }
     }
 
+    void LUTPass::update(ofTexture* depth)
+    {
+        // once a frame so an upload always gets its frame on the gpu before it's used
+        if (updateFrame == ofGetFrameNum()) return;
+        updateFrame = ofGetFrameNum();
+        updateAsyncLoad();
+    }
+
     void LUTPass::render(ofFbo& readFbo, ofFbo& writeFbo)
     {
-        writeFbo.begin();
+        // PostProcessing has already updated, this is for rendering the pass on its own
+        update(NULL);
+
+        beginTarget(writeFbo);
 
         shader.begin();
 
         shader.setUniformTexture("tex", readFbo.getTexture(), 0);
         shader.setUniformTexture("lut_tex", GL_TEXTURE_3D, lut_tex, 1);
+        shader.setUniform1i("lumaToAlpha", writeLumaToAlpha ? 1 : 0);
+        const ofVec3f& domainMin = cube.getDomainMin();
+        const ofVec3f& domainMax = cube.getDomainMax();
+        shader.setUniform3f("domainMin", domainMin.x, domainMin.y, domainMin.z);
+        shader.setUniform3f("domainScale", 1.f / (domainMax.x - domainMin.x), 1.f / (domainMax.y - domainMin.y), 1.f / (domainMax.z - domainMin.z));
 
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
 
         shader.end();
 
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 
-}
\ No newline at end of file
+}
@@ -32,6 +32,8 @@
 #pragma once
 
 #include "RenderPass.h"
+#include "CubeLUT.h"
+#include <future>
 
 namespace itg
 {
@@ -43,14 +45,80 @@ public:
     LUTPass(const ofVec2f& aspect, bool arb);
     ~LUTPass();
 
-    LUTPass*loadLUT(string path);
+    // .cube files are cached after the first load, see CubeLUT
+    LUTPass*loadLUT(string path, bool useCache = true);
+
+    // parses the file on another thread, then copies it into a pbo a chunk a
+    // frame and uploads it from there. The current lut is used until the new
+    // one has been on the gpu for a frame. Loads move along in update(), which
+    // PostProcessing calls every frame even while the pass is disabled or
+    // baked, so the future completes a few frames after the parse: true once
+    // the new lut is in use, false if it couldn't be loaded, another load
+    // replaced it or the pass was destroyed.
+    shared_future<bool> loadLUTAsync(string path, bool useCache = true);
+    bool isLoading() const;
+
+    // milliseconds to parse the last lut that loaded and from the load call until it was in use
+    float getLastParseTime() const { return lastParseTime; }
+    float getLastLoadTime() const { return lastLoadTime; }
+
+    // moves an async load along, before a bake decides whether to redo it
+    void update(ofTexture* depth);
     void render(ofFbo& readFbo, ofFbo& writeFbo);
 
+    bool canWriteLumaToAlpha() const { return true; }
+
+    bool isColorMapping() const { return true; }
+    void getParameters(vector<float>& parameters) const { parameters.push_back(lutVersion); }
+
+    // rgb entries with red changing fastest, empty until a lut is loaded
+    const vector<float>& getLUTData() const { return cube.getData(); }
+    int getLUTSize() const { return cube.getSize(); }
+    const ofVec3f& getDomainMin() const { return cube.getDomainMin(); }
+    const ofVec3f& getDomainMax() const { return cube.getDomainMax(); }
+    const string& getTitle() const { return cube.getTitle(); }
+
 private:
 
+    struct AsyncLoad
+    {
+        string path;
+        bool useCache;
+        CubeLUT cube;
+        uint64_t startTime;
+        float parseTime;
+        promise<bool> parsed;
+        promise<bool> done;
+    };
+
     GLuint lut_tex;
+    // changes whenever a different lut is in use, gl can reuse texture ids
+    unsigned lutVersion;
+    unsigned updateFrame;
+    CubeLUT cube;
     ofShader shader;
 
+    shared_ptr<AsyncLoad> pending;
+    future<bool> pendingParsed;
+    // bytes copied into the mapped pbo each frame
+    static const size_t COPY_CHUNK_SIZE = 1 << 20;
+
+    // parsed and being copied into the mapped pbo
+    shared_ptr<AsyncLoad> copying;
+    size_t copyOffset;
+    char* mappedPbo;
+    shared_ptr<AsyncLoad> uploading;
+    GLuint uploadTex;
+    GLuint pbo;
+    float lastParseTime;
+    float lastLoadTime;
+
+    // usePbo unmaps the pbo updateAsyncLoad() filled and uploads from it
+    GLuint createTexture(const CubeLUT& cube, bool usePbo);
+    bool mapPbo(size_t numBytes);
+    void setupShader();
+    void updateAsyncLoad();
+    void cancelAsyncLoad();
     void dispose();
 };
 }
\ No newline at end of file
@@ -79,7 +79,7 @@ namespace itg
     
     void LimbDarkeningPass::render(ofFbo& readFbo, ofFbo& writeFbo)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         shader.begin();
         shader.setUniformTexture("myTexture", readFbo.getTexture(), 0);
@@ -92,6 +92,6 @@ namespace itg
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
@@ -0,0 +1,168 @@
+/*
+ *  MultisampleFbo.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "MultisampleFbo.h"
+
+namespace itg
+{
+    MultisampleFbo::MultisampleFbo() : fbo(0), color(0), depth(0), previousFbo(0), width(0), height(0), numSamples(0)
+    {
+    }
+    
+    MultisampleFbo::~MultisampleFbo()
+    {
+        release();
+    }
+    
+    bool MultisampleFbo::isAvailable()
+    {
+        static bool available = ofGLCheckExtension("GL_ARB_texture_multisample");
+        return available;
+    }
+    
+    void MultisampleFbo::release()
+    {
+        if (fbo) glDeleteFramebuffers(1, &fbo);
+        if (color) glDeleteTextures(1, &color);
+        if (depth) glDeleteTextures(1, &depth);
+        fbo = color = depth = 0;
+    }
+    
+    void MultisampleFbo::allocate(unsigned width, unsigned height, unsigned numSamples)
+    {
+        release();
+        
+        GLint maxColorSamples, maxDepthSamples;
+        glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &maxColorSamples);
+        glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &maxDepthSamples);
+        this->numSamples = ofClamp(numSamples, 1, min(maxColorSamples, maxDepthSamples));
+        this->width = width;
+        this->height = height;
+        
+        // fixed sample locations so colour and depth samples line up
+        glGenTextures(1, &color);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, color);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, this->numSamples, GL_RGBA8, width, height, GL_TRUE);
+        
+        glGenTextures(1, &depth);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, depth);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, this->numSamples, GL_DEPTH_COMPONENT24, width, height, GL_TRUE);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+        
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, color, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D_MULTISAMPLE, depth, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            ofLogError() << "MultisampleFbo: framebuffer with " << this->numSamples << " samples is incomplete";
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+        
+        if (!resolveShader.isLoaded())
+        {
+            // sampler2DMS needs 1.50, compatibility keeps gl_FragColor and the fixed function vertex stage
+            string fragShaderSrc = STRINGIFY(
+                uniform sampler2DMS colorTex;
+                uniform sampler2DMS depthTex;
+                uniform int numSamples;
+                
+                void main()
+                {
+                    ivec2 texel = ivec2(gl_FragCoord.xy);
+                    vec4 c = vec4(0.0);
+                    float d = 1.0;
+                    for (int i = 0; i < numSamples; ++i)
+                    {
+                        c += texelFetch(colorTex, texel, i);
+                        d = min(d, texelFetch(depthTex, texel, i).r);
+                    }
+                    gl_FragColor = c / float(numSamples);
+                    gl_FragDepth = d;
+                }
+            );
+            resolveShader.setupShaderFromSource(GL_FRAGMENT_SHADER, "#version 150 compatibility\n" + fragShaderSrc);
+            resolveShader.linkProgram();
+        }
+    }
+    
+    void MultisampleFbo::bind()
+    {
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    }
+    
+    void MultisampleFbo::unbind()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    }
+    
+    void MultisampleFbo::resolve(ofFbo& target, bool resolveColor, bool resolveDepth)
+    {
+        if (!resolveColor && !resolveDepth) return;
+        
+        target.begin(OF_FBOMODE_NODEFAULTS);
+        glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDisable(GL_BLEND);
+        glColorMask(resolveColor, resolveColor, resolveColor, resolveColor);
+        // depth is only written with the test on
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_ALWAYS);
+        glDepthMask(resolveDepth);
+        
+        resolveShader.begin();
+        resolveShader.setUniformTexture("colorTex", GL_TEXTURE_2D_MULTISAMPLE, color, 0);
+        resolveShader.setUniformTexture("depthTex", GL_TEXTURE_2D_MULTISAMPLE, depth, 1);
+        resolveShader.setUniform1i("numSamples", numSamples);
+        
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+        glBegin(GL_QUADS);
+        glVertex2f(-1, -1);
+        glVertex2f(1, -1);
+        glVertex2f(1, 1);
+        glVertex2f(-1, 1);
+        glEnd();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+        
+        resolveShader.end();
+        glPopAttrib();
+        target.end();
+    }
+}
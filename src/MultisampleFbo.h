@@ -0,0 +1,85 @@
+/*
+ *  MultisampleFbo.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "RenderPass.h"
+
+namespace itg
+{
+    /*
+     * Multisampled colour and depth textures the scene is drawn into in
+     * place of PostProcessing's raw fbo. Rather than a blit, resolve() reads
+     * the samples with texelFetch in a shader: colour is averaged and depth
+     * takes the nearest sample, and either can be skipped when nothing
+     * reads it. The resolve is a full resolution pass of its own, only a
+     * colour bake at the start of the chain reads the samples in place of
+     * it; other passes have GLSL 110/120 shaders that can't sample a
+     * multisampled texture. Needs GL_ARB_texture_multisample (gl 3.2).
+     */
+    class MultisampleFbo
+    {
+    public:
+        MultisampleFbo();
+        ~MultisampleFbo();
+        
+        static bool isAvailable();
+        
+        // numSamples is clamped to what the gpu supports for both textures
+        void allocate(unsigned width, unsigned height, unsigned numSamples);
+        bool isAllocated() const { return fbo != 0; }
+        
+        // binds over whatever fbo is bound, e.g. inside raw.begin() so
+        // openFrameworks' viewport and matrices are the same as for raw
+        void bind();
+        void unbind();
+        
+        // draws into target, which has to be the same size
+        void resolve(ofFbo& target, bool resolveColor, bool resolveDepth);
+        
+        GLuint getColorTextureId() const { return color; }
+        GLuint getDepthTextureId() const { return depth; }
+        unsigned getNumSamples() const { return numSamples; }
+        unsigned getWidth() const { return width; }
+        unsigned getHeight() const { return height; }
+        
+    private:
+        void release();
+        
+        ofShader resolveShader;
+        GLuint fbo;
+        GLuint color;
+        GLuint depth;
+        GLint previousFbo;
+        unsigned width, height;
+        unsigned numSamples;
+    };
+}
@@ -0,0 +1,249 @@
+/*
+ *  NoiseTextures.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "NoiseTextures.h"
+
+namespace itg
+{
+    namespace
+    {
+        // small deterministic generator so the textures are the same on every platform
+        struct Random
+        {
+            Random(unsigned seed) : state(seed * 747796405u + 2891336453u) {}
+            
+            unsigned next()
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                return state;
+            }
+            
+            float nextFloat() { return (next() >> 8) / 16777216.f; }
+            
+            unsigned state;
+        };
+        
+        float fade(float t)
+        {
+            return t * t * t * (t * (t * 6.f - 15.f) + 10.f);
+        }
+        
+        // one channel of tileable gradient noise
+        void gradientNoise(vector<float>& out, Random& random)
+        {
+            const unsigned size = NoiseTextures::SIZE;
+            const unsigned period = NoiseTextures::PERIOD;
+            vector<ofVec2f> directions(period * period);
+            for (unsigned i = 0; i < directions.size(); ++i)
+            {
+                float angle = random.nextFloat() * TWO_PI;
+                directions[i].set(cosf(angle), sinf(angle));
+            }
+            
+            out.resize(size * size);
+            const float cellSize = (float)size / period;
+            float maxAbs = 1e-6f;
+            for (unsigned y = 0; y < size; ++y)
+            {
+                for (unsigned x = 0; x < size; ++x)
+                {
+                    float px = x / cellSize;
+                    float py = y / cellSize;
+                    unsigned x0 = px, y0 = py;
+                    float fx = px - x0, fy = py - y0;
+                    float corners[4];
+                    for (unsigned c = 0; c < 4; ++c)
+                    {
+                        unsigned dx = c & 1, dy = c >> 1;
+                        unsigned index = ((y0 + dy) % period) * period + (x0 + dx) % period;
+                        corners[c] = directions[index].x * (fx - dx) + directions[index].y * (fy - dy);
+                    }
+                    float u = fade(fx), v = fade(fy);
+                    float value = ofLerp(ofLerp(corners[0], corners[1], u), ofLerp(corners[2], corners[3], u), v);
+                    out[y * size + x] = value;
+                    maxAbs = max(maxAbs, fabsf(value));
+                }
+            }
+            
+            // stretch to [-1, 1] to match the range of the procedural simplex noise
+            for (unsigned i = 0; i < out.size(); ++i) out[i] /= maxAbs;
+        }
+        
+        void loadNoise(ofTexture& texture, Random& random)
+        {
+            const unsigned size = NoiseTextures::SIZE;
+            vector<unsigned char> pixels(4 * size * size);
+            vector<float> channel;
+            for (unsigned c = 0; c < 4; ++c)
+            {
+                gradientNoise(channel, random);
+                for (unsigned i = 0; i < channel.size(); ++i)
+                {
+                    pixels[4 * i + c] = ofClamp(127.5f + 127.5f * channel[i], 0.f, 255.f);
+                }
+            }
+            // not arb so they can repeat and be sampled with 0-1 coordinates
+            texture.allocate(size, size, GL_RGBA, false);
+            texture.loadData(&pixels[0], size, size, GL_RGBA);
+            texture.setTextureWrap(GL_REPEAT, GL_REPEAT);
+            texture.setTextureMinMagFilter(GL_LINEAR, GL_LINEAR);
+        }
+        
+        // void and cluster (Ulichney 1993), ranks every pixel of a toroidal
+        // size x size grid so that each threshold of the ranks is well spread
+        vector<unsigned> voidAndCluster(unsigned size, Random& random)
+        {
+            const unsigned n = size * size;
+            const float sigma = 1.5f;
+            const int radius = 7;
+            
+            vector<float> kernel((2 * radius + 1) * (2 * radius + 1));
+            for (int y = -radius; y <= radius; ++y)
+            {
+                for (int x = -radius; x <= radius; ++x)
+                {
+                    kernel[(y + radius) * (2 * radius + 1) + x + radius] = expf(-(x * x + y * y) / (2.f * sigma * sigma));
+                }
+            }
+            
+            vector<bool> pattern(n, false);
+            vector<float> energy(n, 0.f);
+            // adds the gaussian of a pixel to the energy of its neighbours, wrapping around the edges
+            auto splat = [&](unsigned index, float sign)
+            {
+                int px = index % size, py = index / size;
+                for (int y = -radius; y <= radius; ++y)
+                {
+                    unsigned row = ((py + y + size) % size) * size;
+                    for (int x = -radius; x <= radius; ++x)
+                    {
+                        energy[row + (px + x + size) % size] += sign * kernel[(y + radius) * (2 * radius + 1) + x + radius];
+                    }
+                }
+            };
+            auto tightestCluster = [&]()
+            {
+                unsigned best = 0;
+                float bestEnergy = -1e30f;
+                for (unsigned i = 0; i < n; ++i) if (pattern[i] && energy[i] > bestEnergy) { bestEnergy = energy[i]; best = i; }
+                return best;
+            };
+            auto largestVoid = [&]()
+            {
+                unsigned best = 0;
+                float bestEnergy = 1e30f;
+                for (unsigned i = 0; i < n; ++i) if (!pattern[i] && energy[i] < bestEnergy) { bestEnergy = energy[i]; best = i; }
+                return best;
+            };
+            
+            // initial binary pattern from random points, relaxed by moving the
+            // tightest cluster into the largest void until that stops changing
+            const unsigned numInitial = n / 10;
+            for (unsigned placed = 0; placed < numInitial;)
+            {
+                unsigned index = random.next() % n;
+                if (pattern[index]) continue;
+                pattern[index] = true;
+                splat(index, 1.f);
+                ++placed;
+            }
+            for (unsigned iteration = 0; iteration < n; ++iteration)
+            {
+                unsigned cluster = tightestCluster();
+                pattern[cluster] = false;
+                splat(cluster, -1.f);
+                unsigned gap = largestVoid();
+                pattern[gap] = true;
+                splat(gap, 1.f);
+                if (gap == cluster) break;
+            }
+            
+            vector<unsigned> ranks(n);
+            vector<bool> initialPattern = pattern;
+            vector<float> initialEnergy = energy;
+            
+            // ranks below the initial count come from removing its tightest clusters
+            for (unsigned rank = numInitial; rank-- > 0;)
+            {
+                unsigned cluster = tightestCluster();
+                pattern[cluster] = false;
+                splat(cluster, -1.f);
+                ranks[cluster] = rank;
+            }
+            
+            // ranks above come from filling the largest voids
+            pattern.swap(initialPattern);
+            energy.swap(initialEnergy);
+            for (unsigned rank = numInitial; rank < n; ++rank)
+            {
+                unsigned gap = largestVoid();
+                pattern[gap] = true;
+                splat(gap, 1.f);
+                ranks[gap] = rank;
+            }
+            return ranks;
+        }
+    }
+    
+    NoiseTextures::NoiseTextures() : allocated(false)
+    {
+    }
+    
+    void NoiseTextures::allocate(unsigned seed)
+    {
+        Random random(seed);
+        loadNoise(gradientNoise, random);
+        
+        const unsigned size = BLUE_NOISE_SIZE;
+        vector<unsigned> ranks = voidAndCluster(size, random);
+        vector<unsigned char> pixels(4 * size * size);
+        for (unsigned y = 0; y < size; ++y)
+        {
+            for (unsigned x = 0; x < size; ++x)
+            {
+                unsigned i = y * size + x;
+                unsigned offset = ((y + size / 2) % size) * size + (x + size / 2) % size;
+                pixels[4 * i] = (ranks[i] * 256) / (size * size);
+                pixels[4 * i + 1] = (ranks[offset] * 256) / (size * size);
+                pixels[4 * i + 2] = 0;
+                pixels[4 * i + 3] = 255;
+            }
+        }
+        blueNoise.allocate(size, size, GL_RGBA, false);
+        blueNoise.loadData(&pixels[0], size, size, GL_RGBA);
+        blueNoise.setTextureWrap(GL_REPEAT, GL_REPEAT);
+        blueNoise.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+        
+        allocated = true;
+    }
+}
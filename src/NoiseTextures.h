@@ -0,0 +1,67 @@
+/*
+ *  NoiseTextures.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "RenderPass.h"
+
+namespace itg
+{
+    /*
+     * Noise generated once on the cpu so passes can look it up instead of
+     * evaluating it per pixel. PostProcessing builds these the first time a
+     * pass that uses them is enabled. The gradient noise tiles with
+     * GL_REPEAT and holds four independent noise fields, one per channel,
+     * in 0-1 with 0.5 as zero. The blue noise is a void and cluster
+     * rank map, r is the rank and g the same map offset by half its size.
+     */
+    class NoiseTextures
+    {
+    public:
+        static const unsigned SIZE = 256;
+        // lattice cells across the gradient texture
+        static const unsigned PERIOD = 8;
+        static const unsigned BLUE_NOISE_SIZE = 64;
+        
+        NoiseTextures();
+        
+        void allocate(unsigned seed = 0);
+        bool isAllocated() const { return allocated; }
+        
+        ofTexture& getGradientNoise() { return gradientNoise; }
+        ofTexture& getBlueNoise() { return blueNoise; }
+        
+    private:
+        ofTexture gradientNoise;
+        ofTexture blueNoise;
+        bool allocated;
+    };
+}
@@ -30,11 +30,12 @@
  *
  */
 #include "NoiseWarpPass.h"
+#include "NoiseTextures.h"
 
 namespace itg
 {
     NoiseWarpPass::NoiseWarpPass(const ofVec2f& aspect, bool arb, float frequency, float amplitude, float speed) :
-        frequency(frequency), amplitude(amplitude), speed(speed), RenderPass(aspect, arb, "noisewarp")
+        frequency(frequency), amplitude(amplitude), speed(speed), mode(MODE_PROCEDURAL), RenderPass(aspect, arb, "noisewarp")
     {
         string fragShaderSrc = STRINGIFY(
             uniform sampler2D tex;
@@ -160,6 +161,31 @@ namespace itg
         
         shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
         shader.linkProgram();
+        
+        string textureShaderSrc = STRINGIFY(
+            uniform sampler2D tex;
+            uniform sampler2D noiseTex;
+            
+            uniform float frequency;
+            uniform float amplitude;
+            uniform float period;
+            uniform vec2 rotation;
+            uniform vec2 scroll;
+            
+            void main()
+            {
+                // frequency lattice cells across the screen like the procedural noise
+                vec2 p = gl_TexCoord[0].st * frequency / period;
+                vec2 a = vec2(rotation.x * p.x - rotation.y * p.y, rotation.y * p.x + rotation.x * p.y) + scroll;
+                vec2 b = vec2(rotation.x * p.x + rotation.y * p.y, rotation.x * p.y - rotation.y * p.x) - scroll + 0.5;
+                
+                // two unrelated fields averaged, scaled to keep their spread
+                vec2 noise = (texture2D(noiseTex, a).rg + texture2D(noiseTex, b).ba - 1.0) * 1.41421356;
+                gl_FragColor = texture2D(tex, gl_TexCoord[0].st + amplitude * noise);
+            }
+        );
+        textureShader.setupShaderFromSource(GL_FRAGMENT_SHADER, textureShaderSrc);
+        textureShader.linkProgram();
 #ifdef _ITG_TWEAKABLE
         addParameter("amplitude", this->amplitude, "min=0 max=10");
         addParameter("frequency", this->frequency, "min=0 max=20");
@@ -169,7 +195,29 @@ namespace itg
     
     void NoiseWarpPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth)
     {
-        writeFbo.begin();
+        if (mode == MODE_TEXTURE && noiseTextures)
+        {
+            const float t = speed * ofGetElapsedTimef();
+            const float angle = 0.5f * t;
+            
+            beginTarget(writeFbo);
+            textureShader.begin();
+            textureShader.setUniformTexture("tex", readFbo.getTexture(), 0);
+            textureShader.setUniformTexture("noiseTex", noiseTextures->getGradientNoise(), 1);
+            textureShader.setUniform1f("frequency", frequency);
+            textureShader.setUniform1f("amplitude", amplitude);
+            textureShader.setUniform1f("period", NoiseTextures::PERIOD);
+            textureShader.setUniform2f("rotation", cosf(angle), sinf(angle));
+            textureShader.setUniform2f("scroll", 0.13f * t, 0.07f * t);
+            
+            texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+            
+            textureShader.end();
+            endTarget(writeFbo);
+            return;
+        }
+        
+        beginTarget(writeFbo);
         shader.begin();
         shader.setUniform1f("time", ofGetElapsedTimef());
         shader.setUniformTexture("tex", readFbo.getTexture(), 0);
@@ -180,6 +228,6 @@ namespace itg
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
\ No newline at end of file
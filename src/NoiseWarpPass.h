@@ -40,6 +40,15 @@ namespace itg
     public:
         typedef shared_ptr<NoiseWarpPass> Ptr;
         
+        enum Mode
+        {
+            // 3D simplex noise evaluated per pixel
+            MODE_PROCEDURAL,
+            // two lookups of PostProcessing's tileable gradient noise,
+            // animated by scrolling and rotating them in opposite directions
+            MODE_TEXTURE
+        };
+        
         NoiseWarpPass(const ofVec2f& aspect, bool arb, float frequency = 4.f, float amplitude = .1f, float speed = .1f);
         
         void render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth);
@@ -53,8 +62,17 @@ namespace itg
         float getSpeed() const { return speed; }
         void setSpeed(float speed) { this->speed = speed; }
         
+        Mode getMode() const { return mode; }
+        void setMode(Mode mode) { this->mode = mode; }
+        
+        bool usesNoiseTextures() const { return mode == MODE_TEXTURE; }
+        
+        bool isIdentity() const { return amplitude == 0.f; }
+        
     private:
         ofShader shader;
+        ofShader textureShader;
+        Mode mode;
         float frequency;
         float amplitude;
         float speed;
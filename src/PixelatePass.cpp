@@ -58,7 +58,7 @@ namespace itg
     
     void PixelatePass::render(ofFbo& readFbo, ofFbo& writeFbo)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         shader.begin();
         shader.setUniformTexture("tex", readFbo.getTexture(), 0);
@@ -68,6 +68,6 @@ namespace itg
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
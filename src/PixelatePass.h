@@ -44,6 +44,9 @@ namespace itg
         
         void render(ofFbo& readFbo, ofFbo& writeFbo);
         
+        const ofVec2f& getResolution() const { return resolution; }
+        void setResolution(const ofVec2f& resolution) { this->resolution = resolution; }
+        
     private:
         ofShader shader;
         ofVec2f resolution;
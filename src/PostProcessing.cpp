@@ -34,7 +34,7 @@
 
 namespace itg
 {
-    void PostProcessing::init(unsigned width, unsigned height, bool arb)
+    void PostProcessing::init(unsigned width, unsigned height, bool arb, unsigned numSamples)
     {
         this->width = width;
         this->height = height;
@@ -66,14 +66,39 @@ namespace itg
         s.depthStencilAsTexture = true;
         raw.allocate(s);
         
+        // raw stays the single sampled copy everything else reads
+        if (numSamples > 1)
+        {
+            if (MultisampleFbo::isAvailable()) multisampleFbo.allocate(raw.getWidth(), raw.getHeight(), numSamples);
+            else ofLogWarning() << "PostProcessing: multisampling needs GL_ARB_texture_multisample, drawing without it";
+        }
+        
+        source = &raw;
         numProcessedPasses = 0;
+        numSkippedPasses = 0;
         currentReadFbo = 0;
         flip = true;
+        bakeColorPasses = false;
+        directOutput = false;
+        useOutputTarget = false;
+        multisampleColorPending = false;
+        outputFbo = NULL;
+        outputTarget = OutputTarget();
+        frameInfo = FrameInfo();
     }
     
     void PostProcessing::begin()
     {
+        frameInfo.hasCamera = false;
+        frameInfo.hasPreviousCamera = false;
+        frameInfo.cameraMoved = true;
+        frameInfo.jitter.set(0.f, 0.f);
+        ++frameInfo.frameNumber;
+        
+        latchParameters();
+        
         raw.begin(OF_FBOMODE_NODEFAULTS);
+        if (multisampleFbo.isAllocated()) multisampleFbo.bind();
         
         ofMatrixMode(OF_MATRIX_PROJECTION);
         ofPushMatrix();
@@ -95,11 +120,35 @@ namespace itg
         cam.begin();
         cam.end();
         
+        ofMatrix4x4 projection = cam.getProjectionMatrix(ofRectangle(0, 0, width, height));
+        ofMatrix4x4 viewProjection = cam.getModelViewMatrix() * projection;
+        
+        frameInfo.hasPreviousCamera = frameInfo.hasCamera;
+        frameInfo.previousViewProjection = frameInfo.viewProjection;
+        frameInfo.viewProjection = viewProjection;
+        frameInfo.cameraMoved = !frameInfo.hasPreviousCamera || frameInfo.viewProjection != frameInfo.previousViewProjection;
+        frameInfo.hasCamera = true;
+        frameInfo.cameraNear = cam.getNearClip();
+        frameInfo.cameraFar = cam.getFarClip();
+        frameInfo.jitter.set(0.f, 0.f);
+        ++frameInfo.frameNumber;
+        
+        latchParameters();
+        
+        for (int i = 0; i < passes.size(); ++i)
+        {
+            if (passes[i]->getEnabled() && passes[i]->usesJitter()) frameInfo.jitter = getJitter(frameInfo.frameNumber % 8);
+        }
+        
+        // offset in clip space after the projection
+        if (frameInfo.jitter != ofVec2f()) projection = projection * ofMatrix4x4::newTranslationMatrix(2.f * frameInfo.jitter.x / raw.getWidth(), 2.f * frameInfo.jitter.y / raw.getHeight(), 0.f);
+        
         raw.begin(OF_FBOMODE_NODEFAULTS);
+        if (multisampleFbo.isAllocated()) multisampleFbo.bind();
         
         ofMatrixMode(OF_MATRIX_PROJECTION);
         ofPushMatrix();
-        ofLoadMatrix(cam.getProjectionMatrix(ofRectangle(0, 0, width, height)));
+        ofLoadMatrix(projection);
         
         ofMatrixMode(OF_MATRIX_MODELVIEW);
         ofPushMatrix();
@@ -114,6 +163,37 @@ namespace itg
     }
     
     void PostProcessing::end(bool autoDraw)
+    {
+        endScene();
+        
+        ofPushStyle();
+        glPushAttrib(GL_ENABLE_BIT);
+        glDisable(GL_LIGHTING);
+        ofSetColor(255, 255, 255);
+        if (autoDraw && directOutput) processTo(outputFbo);
+        else
+        {
+            process();
+            if (autoDraw) draw();
+        }
+        glPopAttrib();
+        ofPopStyle();
+    }
+    
+    void PostProcessing::end(ofFbo& output)
+    {
+        endScene();
+        
+        ofPushStyle();
+        glPushAttrib(GL_ENABLE_BIT);
+        glDisable(GL_LIGHTING);
+        ofSetColor(255, 255, 255);
+        processTo(&output);
+        glPopAttrib();
+        ofPopStyle();
+    }
+    
+    void PostProcessing::endScene()
     {
         glPopAttrib();
         ofPopStyle();
@@ -126,16 +206,39 @@ namespace itg
         ofMatrixMode(OF_MATRIX_MODELVIEW);
         ofPopMatrix();
         
+        if (multisampleFbo.isAllocated()) multisampleFbo.unbind();
         raw.end();
-        
-        ofPushStyle();
-        glPushAttrib(GL_ENABLE_BIT);
-        glDisable(GL_LIGHTING);
-        ofSetColor(255, 255, 255);
+    }
+    
+    void PostProcessing::processTo(ofFbo* output)
+    {
+        outputTarget.fbo = output;
+        if (output)
+        {
+            // fbos are drawn into with the first row at the top
+            outputTarget.viewport = ofRectangle(0, 0, output->getWidth(), output->getHeight());
+            outputTarget.flip = flip;
+        }
+        else
+        {
+            // where draw() would put it
+            outputTarget.viewport = ofRectangle(0, ofGetHeight() - height, width, height);
+            outputTarget.flip = !flip;
+        }
+        useOutputTarget = true;
         process();
-        if (autoDraw) draw();
-        glPopAttrib();
-        ofPopStyle();
+        useOutputTarget = false;
+        
+        if (!outputTarget.drawn)
+        {
+            if (output)
+            {
+                output->begin();
+                draw(0, 0, output->getWidth(), output->getHeight());
+                output->end();
+            }
+            else draw();
+        }
     }
     
     void PostProcessing::debugDraw()
@@ -159,7 +262,7 @@ namespace itg
             ofScale(1, -1, 1);
         }
         else glTranslatef(x, y, 0);
-        if (numProcessedPasses == 0) raw.draw(0, 0, w, h);
+        if (numProcessedPasses == 0) source->draw(0, 0, w, h);
         else pingPong[currentReadFbo].draw(0, 0, w, h);
         if (flip) ofPopMatrix();
     }
@@ -167,39 +270,287 @@ namespace itg
     ofTexture& PostProcessing::getProcessedTextureReference()
     {
         if (numProcessedPasses) return pingPong[currentReadFbo].getTexture();
-        else return raw.getTexture();
+        else return source->getTexture();
     }
     
     // need to have depth enabled for some fx
     void PostProcessing::process(ofFbo& raw, bool hasDepthAsTexture)
     {
+        latchParameters();
+        updatePasses(hasDepthAsTexture ? &raw.getDepthTexture() : NULL);
+        processChain(raw, hasDepthAsTexture ? &raw.getDepthTexture() : NULL);
+    }
+    
+    void PostProcessing::process(ofTexture& input, ofTexture* depth, ofFbo& output)
+    {
+        GLenum target = arb ? GL_TEXTURE_RECTANGLE_ARB : GL_TEXTURE_2D;
+        if (input.getTextureData().textureTarget != target)
+        {
+            ofLogError() << "PostProcessing: input texture has to be " << (arb ? "GL_TEXTURE_RECTANGLE_ARB" : "GL_TEXTURE_2D") << " to match arb";
+            return;
+        }
+        
+        // passes read from an fbo so attach the texture to one, nothing is copied
+        if (!inputFbo.isAllocated() || inputFbo.getNumTextures() == 0 ||
+            inputFbo.getTexture().getTextureData().textureID != input.getTextureData().textureID ||
+            inputFbo.getWidth() != input.getWidth() || inputFbo.getHeight() != input.getHeight())
+        {
+            ofFbo::Settings s;
+            s.width = input.getWidth();
+            s.height = input.getHeight();
+            s.textureTarget = target;
+            s.numColorbuffers = 0;
+            inputFbo.allocate(s);
+            inputFbo.attachTexture(input, input.getTextureData().glInternalFormat, 0);
+        }
+        
+        latchParameters();
+        updatePasses(depth);
+        
+        // first row stays first as passes keep the orientation of their input
+        outputTarget.fbo = &output;
+        outputTarget.viewport = ofRectangle(0, 0, output.getWidth(), output.getHeight());
+        outputTarget.flip = false;
+        useOutputTarget = true;
+        processChain(inputFbo, depth);
+        useOutputTarget = false;
+        
+        if (!outputTarget.drawn)
+        {
+            output.begin();
+            getProcessedTextureReference().draw(0, 0, output.getWidth(), output.getHeight());
+            output.end();
+        }
+    }
+    
+    void PostProcessing::processChain(ofFbo& input, ofTexture* depth)
+    {
+        source = &input;
+        
+        bool buildDepthPyramid = false;
+        if (depth && frameInfo.hasCamera)
+        {
+            for (int i = 0; i < passes.size(); ++i)
+            {
+                if (passes[i]->getEnabled() && passes[i]->usesDepthPyramid()) buildDepthPyramid = true;
+            }
+        }
+        if (buildDepthPyramid)
+        {
+            if (!depthPyramid.isAllocated() || depthPyramid.getTexture().getWidth() != depth->getWidth() || depthPyramid.getTexture().getHeight() != depth->getHeight())
+            {
+                depthPyramid.allocate(depth->getWidth(), depth->getHeight(), arb);
+            }
+            depthPyramid.update(*depth, frameInfo.cameraNear, frameInfo.cameraFar);
+        }
+        for (int i = 0; i < passes.size(); ++i)
+        {
+            if (!noiseTextures.isAllocated() && passes[i]->getEnabled() && passes[i]->usesNoiseTextures()) noiseTextures.allocate();
+        }
+        for (int i = 0; i < passes.size(); ++i)
+        {
+            passes[i]->setDepthPyramid(buildDepthPyramid ? &depthPyramid : NULL);
+            passes[i]->setNoiseTextures(noiseTextures.isAllocated() ? &noiseTextures : NULL);
+            passes[i]->setFrameInfo(&frameInfo);
+        }
+        
+        RenderPass::Ptr previous;
+        for (int i = 0; i < passes.size(); ++i)
+        {
+            passes[i]->setWriteLumaToAlpha(false);
+            passes[i]->setReadLumaFromAlpha(false);
+            if (passes[i]->getEnabled() && (!arb || passes[i]->hasArbShader()) && !passes[i]->isIdentity())
+            {
+                if (previous && previous->canWriteLumaToAlpha() && passes[i]->canReadLumaFromAlpha())
+                {
+                    previous->setWriteLumaToAlpha(true);
+                    passes[i]->setReadLumaFromAlpha(true);
+                }
+                previous = passes[i];
+            }
+        }
+        
+        // the last pass that renders draws to the output if it can
+        RenderPass* lastPass = NULL;
+        outputTarget.drawn = false;
+        if (useOutputTarget)
+        {
+            for (int i = passes.size() - 1; i >= 0 && !lastPass; --i)
+            {
+                if (passes[i]->getEnabled() && (!arb || passes[i]->hasArbShader()) && !passes[i]->isIdentity()) lastPass = passes[i].get();
+            }
+            // a pass in a colour bake run renders into the bake's strip, the bake itself is drawn as before
+            if (lastPass && endsWithColorBake()) lastPass = NULL;
+            if (lastPass) lastPass->setOutputTarget(&outputTarget);
+        }
+        
         numProcessedPasses = 0;
+        numSkippedPasses = 0;
+        unsigned numColorBakes = 0;
         for (int i = 0; i < passes.size(); ++i)
         {
             if (passes[i]->getEnabled())
             {
+                // luma in alpha isn't coverage, blending with it would scale the colour
+                const bool lumaToAlpha = passes[i]->getWriteLumaToAlpha();
+                if (lumaToAlpha)
+                {
+                    glPushAttrib(GL_COLOR_BUFFER_BIT);
+                    glDisable(GL_BLEND);
+                }
+                
                 if (arb && !passes[i]->hasArbShader()) ofLogError() << "Arb mode is enabled but pass " << passes[i]->getName() << " does not have an arb shader.";
+                // nothing to render and no swap so the next pass reads what this one would have
+                else if (passes[i]->isIdentity()) numSkippedPasses++;
+                else if (bakeColorPasses && !arb && passes[i]->isColorMapping())
+                {
+                    // disabled and identity passes don't break a run
+                    vector<RenderPass*> run;
+                    int last = i;
+                    for (int j = i; j < passes.size(); ++j)
+                    {
+                        if (!passes[j]->getEnabled()) continue;
+                        if (!passes[j]->isColorMapping()) break;
+                        if (passes[j]->isIdentity()) continue;
+                        run.push_back(passes[j].get());
+                        last = j;
+                    }
+                    
+                    ofFbo& readFbo = numProcessedPasses == 0 ? input : pingPong[currentReadFbo];
+                    if (run.size() > 1)
+                    {
+                        if (colorBakes.size() <= numColorBakes) colorBakes.push_back(ColorBake::Ptr(new ColorBake()));
+                        ColorBake& colorBake = *colorBakes[numColorBakes++];
+                        colorBake.update(run);
+                        if (multisampleColorPending)
+                        {
+                            colorBake.render(multisampleFbo, pingPong[1 - currentReadFbo], run.back()->getWriteLumaToAlpha());
+                            multisampleColorPending = false;
+                        }
+                        else colorBake.render(readFbo, pingPong[1 - currentReadFbo], run.back()->getWriteLumaToAlpha());
+                        for (int j = i; j <= last; ++j)
+                        {
+                            if (passes[j]->getEnabled() && passes[j]->isIdentity()) numSkippedPasses++;
+                        }
+                        i = last;
+                    }
+                    else if (depth) passes[i]->render(readFbo, pingPong[1 - currentReadFbo], *depth);
+                    else passes[i]->render(readFbo, pingPong[1 - currentReadFbo]);
+                    // nothing was written to the ping pong when the pass drew to the output
+                    if (!outputTarget.drawn)
+                    {
+                        currentReadFbo = 1 - currentReadFbo;
+                        numProcessedPasses++;
+                    }
+                }
                 else
                 {
-                    if (hasDepthAsTexture)
+                    if (depth)
                     {
-                        if (numProcessedPasses == 0) passes[i]->render(raw, pingPong[1 - currentReadFbo], raw.getDepthTexture());
-                        else passes[i]->render(pingPong[currentReadFbo], pingPong[1 - currentReadFbo], raw.getDepthTexture());
+                        if (numProcessedPasses == 0) passes[i]->render(input, pingPong[1 - currentReadFbo], *depth);
+                        else passes[i]->render(pingPong[currentReadFbo], pingPong[1 - currentReadFbo], *depth);
                     }
                     else
                     {
-                        if (numProcessedPasses == 0) passes[i]->render(raw, pingPong[1 - currentReadFbo]);
+                        if (numProcessedPasses == 0) passes[i]->render(input, pingPong[1 - currentReadFbo]);
                         else passes[i]->render(pingPong[currentReadFbo], pingPong[1 - currentReadFbo]);
                     }
-                    currentReadFbo = 1 - currentReadFbo;
-                    numProcessedPasses++;
+                    // nothing was written to the ping pong when the pass drew to the output
+                    if (!outputTarget.drawn)
+                    {
+                        currentReadFbo = 1 - currentReadFbo;
+                        numProcessedPasses++;
+                    }
                 }
+                
+                if (lumaToAlpha) glPopAttrib();
+            }
+        }
+        if (lastPass) lastPass->setOutputTarget(NULL);
+    }
+    
+    ofVec2f PostProcessing::getJitter(unsigned index)
+    {
+        // first point of the sequence is 0 so skip it
+        ofVec2f jitter;
+        unsigned bases[] = { 2, 3 };
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            float f = 1.f;
+            float r = 0.f;
+            for (unsigned n = index + 1; n > 0; n /= bases[i])
+            {
+                f /= bases[i];
+                r += f * (n % bases[i]);
             }
+            jitter[i] = r - 0.5f;
         }
+        return jitter;
+    }
+    
+    void PostProcessing::updatePasses(ofTexture* depth)
+    {
+        for (int i = 0; i < passes.size(); ++i) passes[i]->update(depth);
     }
     
     void PostProcessing::process()
     {
-        process(raw);
+        // before the resolve, which depends on what's skipped
+        updatePasses(&raw.getDepthTexture());
+        if (multisampleFbo.isAllocated())
+        {
+            bool resolveDepth = false;
+            for (int i = 0; i < passes.size(); ++i)
+            {
+                if (passes[i]->getEnabled() && passes[i]->usesDepth()) resolveDepth = true;
+            }
+            // a colour bake first reads the samples itself so raw's colour isn't needed
+            multisampleColorPending = startsWithColorBake();
+            multisampleFbo.resolve(raw, !multisampleColorPending, resolveDepth);
+        }
+        // parameters were latched in begin()
+        processChain(raw, &raw.getDepthTexture());
+        multisampleColorPending = false;
+    }
+    
+    void PostProcessing::latchParameters()
+    {
+        for (int i = 0; i < passes.size(); ++i) passes[i]->latchParameters();
+    }
+    
+    bool PostProcessing::startsWithColorBake() const
+    {
+        if (!bakeColorPasses || arb) return false;
+        
+        // same as the run process() bakes from the first pass it renders,
+        // skipped passes before it don't count but inside the run only
+        // colour mapping ones are skipped
+        int first = 0;
+        while (first < passes.size() && (!passes[first]->getEnabled() || passes[first]->isIdentity())) ++first;
+        unsigned runSize = 0;
+        for (int i = first; i < passes.size(); ++i)
+        {
+            if (!passes[i]->getEnabled()) continue;
+            if (!passes[i]->isColorMapping()) break;
+            if (!passes[i]->isIdentity()) runSize++;
+        }
+        return runSize > 1;
+    }
+    
+    bool PostProcessing::endsWithColorBake() const
+    {
+        if (!bakeColorPasses || arb) return false;
+        
+        // the run containing the last pass process() renders, walked backwards
+        int last = passes.size() - 1;
+        while (last >= 0 && (!passes[last]->getEnabled() || passes[last]->isIdentity())) --last;
+        unsigned runSize = 0;
+        for (int i = last; i >= 0; --i)
+        {
+            if (!passes[i]->getEnabled()) continue;
+            if (!passes[i]->isColorMapping()) break;
+            if (!passes[i]->isIdentity()) runSize++;
+        }
+        return runSize > 1;
     }
 }
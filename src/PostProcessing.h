@@ -32,6 +32,10 @@
 #pragma once
 
 #include "RenderPass.h"
+#include "DepthPyramid.h"
+#include "ColorBake.h"
+#include "NoiseTextures.h"
+#include "MultisampleFbo.h"
 #include "ofCamera.h"
 
 namespace itg
@@ -41,10 +45,16 @@ namespace itg
     public:
         typedef shared_ptr<PostProcessing> Ptr;
         
-        void init(unsigned width = ofGetWidth(), unsigned height = ofGetHeight(), bool arb = false);
+        // numSamples above 1 draws the scene multisampled, see MultisampleFbo.
+        // The samples are resolved into raw before the passes run unless the
+        // chain starts with colour passes that are baked
+        void init(unsigned width = ofGetWidth(), unsigned height = ofGetHeight(), bool arb = false, unsigned numSamples = 0);
         void begin();
         void begin(ofCamera& cam);
         void end(bool autoDraw = true);
+        // processes and draws into output instead of the screen, the last pass
+        // writes straight to it when it can
+        void end(ofFbo& output);
         
         // float rather than int and not const to override ofBaseDraws
         void draw(float x = 0.f, float y = 0.f) const;
@@ -67,6 +77,14 @@ namespace itg
         // advanced
         void process(ofFbo& raw, bool hasDepthAsTexture = true);
         
+        // runs the passes on a texture from elsewhere, e.g. a g-buffer or a
+        // video, and writes the result into output with the same orientation.
+        // The texture is read in place and the last pass writes to output
+        // directly when it can so there are no copies. It has to be
+        // GL_TEXTURE_2D, or a rectangle texture in arb mode. depth can be
+        // NULL, passes that need a camera use the one from the last begin(cam).
+        void process(ofTexture& input, ofTexture* depth, ofFbo& output);
+        
         /**
          * Set flip.
          * Turn on if using ofEasyCam to fix flipping bug.
@@ -78,19 +96,78 @@ namespace itg
         vector<RenderPass::Ptr>& getPasses() { return passes; }
         unsigned getNumProcessedPasses() const { return numProcessedPasses; }
         
+        // enabled passes that weren't rendered last frame because they'd have left the image unchanged
+        unsigned getNumSkippedPasses() const { return numSkippedPasses; }
+        
+        // when multisampled, raw's colour isn't resolved on frames where a
+        // colour bake reads the samples itself
         ofFbo& getRawRef() { return raw; }
         
+        MultisampleFbo& getMultisampleFboRef() { return multisampleFbo; }
+        unsigned getNumSamples() const { return multisampleFbo.isAllocated() ? multisampleFbo.getNumSamples() : 1; }
+        
+        // only built for frames drawn with begin(cam) when a pass uses it
+        DepthPyramid& getDepthPyramidRef() { return depthPyramid; }
+        
+        // generated the first time an enabled pass uses them
+        NoiseTextures& getNoiseTexturesRef() { return noiseTextures; }
+        
+        const FrameInfo& getFrameInfo() const { return frameInfo; }
+        
+        // halton (2, 3) sequence offset in [-0.5, 0.5) pixels, the camera is
+        // jittered by the first 8 when a pass uses it
+        static ofVec2f getJitter(unsigned index);
+        
+        // replaces runs of two or more enabled colour mapping passes, e.g.
+        // contrast, hsb shift and bleach bypass, with a single LUT lookup
+        // that's baked again when their parameters change
+        void setBakeColorPasses(bool bakeColorPasses) { this->bakeColorPasses = bakeColorPasses; }
+        bool getBakeColorPasses() const { return bakeColorPasses; }
+        vector<ColorBake::Ptr>& getColorBakes() { return colorBakes; }
+        
+        // end(true) has the last pass draw straight to the screen, or to
+        // outputFbo when it's set, instead of into a ping pong fbo that's then
+        // drawn. Passes that can't, e.g. fxaa, ssao and colour bakes, are
+        // drawn as before. The last pass drawn this way isn't counted in
+        // getNumProcessedPasses() and the processed texture holds its input.
+        void setDirectOutput(bool directOutput, ofFbo* outputFbo = NULL) { this->directOutput = directOutput; this->outputFbo = outputFbo; }
+        bool getDirectOutput() const { return directOutput; }
+        bool getDrewDirectOutput() const { return outputTarget.drawn; }
+        
     private:
         void process();
+        void processChain(ofFbo& input, ofTexture* depth);
+        void processTo(ofFbo* output);
+        void endScene();
+        void latchParameters();
+        void updatePasses(ofTexture* depth);
+        bool startsWithColorBake() const;
+        bool endsWithColorBake() const;
         
         unsigned currentReadFbo;
         unsigned numProcessedPasses;
+        unsigned numSkippedPasses;
         unsigned width, height;
         bool flip;
         bool arb;
+        bool bakeColorPasses;
+        bool directOutput;
+        bool useOutputTarget;
+        bool multisampleColorPending;
+        ofFbo* outputFbo;
+        OutputTarget outputTarget;
+        FrameInfo frameInfo;
         
         ofFbo raw;
+        // wraps the texture given to process(input, depth, output)
+        ofFbo inputFbo;
+        // what the first pass read last frame
+        ofFbo* source;
         ofFbo pingPong[2];
         vector<RenderPass::Ptr> passes;
+        MultisampleFbo multisampleFbo;
+        DepthPyramid depthPyramid;
+        NoiseTextures noiseTextures;
+        vector<ColorBake::Ptr> colorBakes;
     };
 }
@@ -63,7 +63,7 @@ namespace itg
 
     void RGBShiftPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         
         shader.begin();
@@ -75,6 +75,6 @@ namespace itg
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
\ No newline at end of file
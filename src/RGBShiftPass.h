@@ -53,6 +53,8 @@ namespace itg
         void setAmount(float v) { amount = v; }
         
         float getAngle() { return angle; }
+        
+        bool isIdentity() const { return amount == 0.f; }
         void setAngle(float v) { angle = v; }
     private:
         
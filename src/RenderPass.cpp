@@ -35,11 +35,11 @@ namespace itg
 {
     RenderPass::RenderPass(const ofVec2f& aspect, bool arb, const string& name) :
 #ifdef _ITG_TWEAKABLE
-        aspect(aspect), enabled(true), arb(arb), Tweakable(name)
+        aspect(aspect), enabled(true), arb(arb), depthPyramid(NULL), noiseTextures(NULL), frameInfo(NULL), outputTarget(NULL), backend(BACKEND_FRAGMENT), writeLumaToAlpha(false), readLumaFromAlpha(false), Tweakable(name)
     {
         addParameter("enable", enabled);
 #else
-        aspect(aspect), enabled(true), arb(arb), name(name)
+        aspect(aspect), enabled(true), arb(arb), depthPyramid(NULL), noiseTextures(NULL), frameInfo(NULL), outputTarget(NULL), backend(BACKEND_FRAGMENT), writeLumaToAlpha(false), readLumaFromAlpha(false), name(name)
     {
 #endif
     }
@@ -49,6 +49,76 @@ namespace itg
         render(readFbo, writeFbo);
     }
     
+    bool RenderPass::isComputeAvailable()
+    {
+#if !defined(TARGET_OPENGLES) && defined(GL_COMPUTE_SHADER)
+        static bool available = ofGLCheckExtension("GL_ARB_compute_shader");
+        return available;
+#else
+        return false;
+#endif
+    }
+    
+    string RenderPass::getLumaToAlphaSrc()
+    {
+        return STRINGIFY(
+            uniform bool lumaToAlpha;
+            
+            vec4 applyLumaToAlpha(vec4 color)
+            {
+                if (lumaToAlpha) color.a = dot(clamp(color.rgb, 0.0, 1.0), vec3(0.299, 0.587, 0.114));
+                return color;
+            }
+        );
+    }
+    
+    void RenderPass::beginTarget(ofFbo& writeFbo)
+    {
+        if (!outputTarget)
+        {
+            writeFbo.begin();
+            return;
+        }
+        
+        if (outputTarget->fbo) outputTarget->fbo->begin(OF_FBOMODE_NODEFAULTS);
+        
+        const ofRectangle& viewport = outputTarget->viewport;
+        glPushAttrib(GL_VIEWPORT_BIT | GL_SCISSOR_BIT);
+        glViewport(viewport.x, viewport.y, viewport.width, viewport.height);
+        // a pass that clears only clears its part of the target
+        glScissor(viewport.x, viewport.y, viewport.width, viewport.height);
+        glEnable(GL_SCISSOR_TEST);
+        
+        // the quad covering writeFbo covers the viewport, first row at the bottom unless flipped
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        if (outputTarget->flip) glOrtho(0, writeFbo.getWidth(), writeFbo.getHeight(), 0, -1, 1);
+        else glOrtho(0, writeFbo.getWidth(), 0, writeFbo.getHeight(), -1, 1);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+        
+        outputTarget->drawn = true;
+    }
+    
+    void RenderPass::endTarget(ofFbo& writeFbo)
+    {
+        if (!outputTarget)
+        {
+            writeFbo.end();
+            return;
+        }
+        
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+        glPopAttrib();
+        
+        if (outputTarget->fbo) outputTarget->fbo->end();
+    }
+    
     void RenderPass::texturedQuad(float x, float y, float width, float height, float s, float t)
     {
         // TODO: change to triangle fan/strip
@@ -45,6 +45,48 @@
 namespace itg
 {
     using namespace std;
+    
+    class DepthPyramid;
+    class NoiseTextures;
+    
+    /*
+     * Camera state of the frame being processed, only valid when it was
+     * drawn with PostProcessing::begin(cam). The view projection matrices
+     * don't include the jitter.
+     */
+    struct FrameInfo
+    {
+        FrameInfo() : hasCamera(false), hasPreviousCamera(false), cameraMoved(true), cameraNear(1.f), cameraFar(1000.f), frameNumber(0) {}
+        
+        ofMatrix4x4 viewProjection;
+        ofMatrix4x4 previousViewProjection;
+        // sub pixel offset the scene was drawn with, in pixels of the raw fbo
+        ofVec2f jitter;
+        bool hasCamera;
+        bool hasPreviousCamera;
+        bool cameraMoved;
+        float cameraNear;
+        float cameraFar;
+        unsigned frameNumber;
+    };
+    
+    /*
+     * Where PostProcessing has the last pass write instead of its write fbo.
+     * The viewport is in pixels of the target with y up, flip puts the first
+     * row of the image at the top of it.
+     */
+    struct OutputTarget
+    {
+        OutputTarget() : fbo(NULL), flip(false), drawn(false) {}
+        
+        // NULL for the framebuffer that's bound
+        ofFbo* fbo;
+        ofRectangle viewport;
+        bool flip;
+        // set when the pass wrote to the target
+        bool drawn;
+    };
+    
     class RenderPass
 #ifdef _ITG_TWEAKABLE
         : public Tweakable
@@ -53,6 +95,14 @@ namespace itg
     public:
         typedef shared_ptr<RenderPass> Ptr;
         
+        enum Backend
+        {
+            BACKEND_FRAGMENT,
+            // gl 4.3 compute shaders for passes that have one, others and
+            // contexts without compute support use the fragment shader
+            BACKEND_COMPUTE
+        };
+        
         RenderPass(const ofVec2f& aspect, bool arb, const string& name);
         
         virtual void render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth);
@@ -72,17 +122,99 @@ namespace itg
         void setArb(bool arb) { this->arb = arb; }
         
         virtual bool hasArbShader() { return false; }
+        
+        void setBackend(Backend backend) { this->backend = backend; }
+        Backend getBackend() const { return backend; }
+        virtual bool hasComputeShader() { return false; }
+        static bool isComputeAvailable();
+        
+        // return true if the pass reads the depth texture this frame in update()
+        // or render(), PostProcessing only resolves a multisampled depth buffer
+        // when a pass does
+        virtual bool usesDepth() const { return usesDepthPyramid(); }
+        
+        // return true to have PostProcessing build the shared linear depth
+        // pyramid when it has a camera, check depthPyramid as it can be NULL
+        virtual bool usesDepthPyramid() const { return false; }
+        void setDepthPyramid(DepthPyramid* depthPyramid) { this->depthPyramid = depthPyramid; }
+        
+        // return true to have PostProcessing generate its shared noise textures, check noiseTextures as it can be NULL
+        virtual bool usesNoiseTextures() const { return false; }
+        void setNoiseTextures(NoiseTextures* noiseTextures) { this->noiseTextures = noiseTextures; }
+        
+        // return true to have PostProcessing jitter the camera by a sub pixel offset each frame
+        virtual bool usesJitter() const { return false; }
+        void setFrameInfo(const FrameInfo* frameInfo) { this->frameInfo = frameInfo; }
+        
+        // PostProcessing pairs a pass that can read luma from alpha with the
+        // pass before it when that one can write it, e.g. fxaa after a colour pass
+        virtual bool canWriteLumaToAlpha() const { return false; }
+        virtual bool canReadLumaFromAlpha() const { return false; }
+        void setWriteLumaToAlpha(bool writeLumaToAlpha) { this->writeLumaToAlpha = writeLumaToAlpha; }
+        void setReadLumaFromAlpha(bool readLumaFromAlpha) { this->readLumaFromAlpha = readLumaFromAlpha; }
+        bool getWriteLumaToAlpha() const { return writeLumaToAlpha; }
+        
+        // declares the lumaToAlpha uniform and vec4 applyLumaToAlpha(vec4 color),
+        // put it in front of the fragment source of a pass that can write luma
+        static string getLumaToAlphaSrc();
+        
+        // return true if each output colour only depends on the input colour
+        // of the same pixel, PostProcessing can then bake runs of these into
+        // a LUT. The bake is done with opaque input so alpha has to be kept
+        // or set to 1 and only change the colour through its input alpha.
+        virtual bool isColorMapping() const { return false; }
+        
+        // appends everything that changes the pass's output, a bake is redone when these change
+        virtual void getParameters(vector<float>& parameters) const {}
+        
+        // PostProcessing sets this on the last pass when it draws straight to the output
+        void setOutputTarget(OutputTarget* outputTarget) { this->outputTarget = outputTarget; }
+        
+        // PostProcessing calls this on the render thread at the start of each
+        // frame, passes whose parameters are set from other threads pick up
+        // the newest ones here, see TripleBuffer
+        virtual void latchParameters() {}
+        
+        // PostProcessing calls this on every pass, enabled or not, once a frame
+        // before it decides which to skip, for state that isIdentity() depends
+        // on and work that has to go on while the pass isn't rendered. depth
+        // can be NULL and may be from the previous frame when multisampled.
+        virtual void update(ofTexture* depth) {}
+        
+        // return true when rendering would give back the input, PostProcessing
+        // then skips the pass without a copy. Passes that always write alpha 1
+        // count as unchanged for opaque input.
+        virtual bool isIdentity() const { return false; }
 
 #ifndef _ITG_TWEAKABLE
         string getName() const { return name; }
 #endif
 
     protected:
+        bool useCompute() { return backend == BACKEND_COMPUTE && hasComputeShader() && isComputeAvailable(); }
+        
         void texturedQuad(float x, float y, float width, float height, float s = 1.0, float t = 1.0);
         
+        // use these instead of writeFbo.begin() and end() around the pass's
+        // final write, they draw to the output target when there is one.
+        // Passes that don't are drawn to the output by PostProcessing as before.
+        void beginTarget(ofFbo& writeFbo);
+        void endTarget(ofFbo& writeFbo);
+        bool hasOutputTarget() const { return outputTarget != NULL; }
+        
         ofVec2f aspect;
         
         bool arb;
+        
+        DepthPyramid* depthPyramid;
+        NoiseTextures* noiseTextures;
+        const FrameInfo* frameInfo;
+        OutputTarget* outputTarget;
+        
+        Backend backend;
+        
+        bool writeLumaToAlpha;
+        bool readLumaFromAlpha;
     
     private:
 #ifndef _ITG_TWEAKABLE
@@ -90,7 +90,7 @@ namespace itg
     
     void RimHighlightingPass::render(ofFbo& readFbo, ofFbo& writeFbo)
     {
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         shader.begin();
         shader.setUniformTexture("myTexture", readFbo.getTexture(), 0);
@@ -98,6 +98,6 @@ namespace itg
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
@@ -30,15 +30,39 @@
  *
  */
 #include "SSAOPass.h"
+#include "DepthPyramid.h"
 #include "ofMain.h"
 
 namespace itg
 {
     SSAOPass::SSAOPass(const ofVec2f& aspect, bool arb, float cameraNear, float cameraFar, float fogNear, float fogFar, bool fogEnabled, bool onlyAO, float aoClamp, float lumInfluence) :
-        cameraNear(cameraNear), cameraFar(cameraFar), fogNear(fogNear), fogFar(fogFar), fogEnabled(fogEnabled), onlyAO(onlyAO), aoClamp(aoClamp), lumInfluence(lumInfluence), RenderPass(aspect, arb, "SSAO")
+        accumulate(false), RenderPass(aspect, arb, "SSAO")
     {
+        Parameters p = { cameraNear, cameraFar, fogNear, fogFar, fogEnabled, onlyAO, aoClamp, lumInfluence };
+        parameters.write(p);
+        parameters.latch();
         
-        string fragShaderSrc = STRINGIFY(
+        // applies the occlusion to the colour, shared with the shader that composites accumulated occlusion
+        string compositeSrc = STRINGIFY(
+            uniform bool onlyAO; 		// use only ambient occlusion pass?
+            uniform float lumInfluence;  // how much luminance affects occlusion
+
+            const vec3 onlyAOColor = vec3( 1.0, 0.7, 0.5 );
+            //const vec3 onlyAOColor = vec3( 1.0, 1.0, 1.0 );,
+
+            vec3 composite( vec3 color, float ao ) {
+                vec3 lumcoeff = vec3( 0.299, 0.587, 0.114 );
+                float lum = dot( color.rgb, lumcoeff );
+                vec3 luminance = vec3( lum );
+                vec3 final = vec3( color * mix( vec3( ao ), vec3( 1.0 ), luminance * lumInfluence ) );
+                if ( onlyAO ) {
+                    final = onlyAOColor * vec3( mix( vec3( ao ), vec3( 1.0 ), luminance * lumInfluence ) );
+                }
+                return final;
+            }
+        );
+        
+        string fragShaderSrc = compositeSrc + STRINGIFY(
             uniform float cameraNear;
             uniform float cameraFar;
 
@@ -46,15 +70,18 @@ namespace itg
             uniform float fogFar;
 
             uniform bool fogEnabled;		// attenuate AO with linear fog
-            uniform bool onlyAO; 		// use only ambient occlusion pass?
+            uniform bool writeAO;		// write the occlusion alone for the accumulator
 
             uniform vec2 size;			// texture width, height
             uniform float aoClamp; 		// depth clamp - reduces haloing at screen edges
 
-            uniform float lumInfluence;  // how much luminance affects occlusion
+            uniform float patternRotation; // fraction of a turn to rotate the samples by
 
             uniform sampler2D tDiffuse;
             uniform sampler2D tDepth;
+            
+            uniform bool useLinearDepth; // read eye space depth from the shared pyramid
+            uniform sampler2D tLinearDepth;
 
             //const float PI = 3.14159265;
             const float DL = 2.399963229728653; // PI * ( 3.0 - sqrt( 5.0 ) )
@@ -80,10 +107,6 @@ namespace itg
             const float diffArea = 0.4; 		// self-shadowing reduction
             const float gDisplace = 0.4; 	// gauss bell center
 
-            const vec3 onlyAOColor = vec3( 1.0, 0.7, 0.5 );
-            //const vec3 onlyAOColor = vec3( 1.0, 1.0, 1.0 );,
-
-
             // RGBA depth
 
             float unpackDepth( const in vec4 rgba_depth ) {
@@ -120,6 +143,9 @@ namespace itg
 
             float doFog() {
                 vec2 vUv = gl_TexCoord[0].st;
+                if ( useLinearDepth ) {
+                    return smoothstep( fogNear, fogFar, texture2D( tLinearDepth, vUv ).r );
+                }
                 float zdepth = unpackDepth( texture2D( tDepth, vUv ) );
                 float depth = -cameraFar * cameraNear / ( zdepth * cameraFarMinusNear - cameraFar );
 
@@ -129,6 +155,12 @@ namespace itg
 
             float readDepth( const in vec2 coord ) {
 
+                // same mapping as below from eye space depth
+                if ( useLinearDepth ) {
+                    float linearDepth = texture2D( tLinearDepth, coord ).r;
+                    return 2.0 * linearDepth / ( linearDepth + cameraFar );
+                }
+
                 //return ( 2.0 * cameraNear ) / ( cameraFar + cameraNear - unpackDepth( texture2D( tDepth, coord ) ) * ( cameraFar - cameraNear ) );,
                 return cameraCoef / ( cameraFarPlusNear - unpackDepth( texture2D( tDepth, coord ) ) * cameraFarMinusNear );
 
@@ -190,7 +222,7 @@ namespace itg
                 float ao;
                 float dz = 1.0 / float( samples );
                 float z = 1.0 - dz / 2.0;
-                float l = 0.0;
+                float l = patternRotation * 6.28318531;
                 for ( int i = 0; i <= samples; i ++ ) {
                  float r = sqrt( 1.0 - z );
                  pw = cos( l ) * r;
@@ -204,15 +236,11 @@ namespace itg
                 if ( fogEnabled ) {
                  ao = mix( ao, 1.0, doFog() );
                 }
-                vec3 color = texture2D( tDiffuse, vUv ).rgb;
-                vec3 lumcoeff = vec3( 0.299, 0.587, 0.114 );
-                float lum = dot( color.rgb, lumcoeff );
-                vec3 luminance = vec3( lum );
-                vec3 final = vec3( color * mix( vec3( ao ), vec3( 1.0 ), luminance * lumInfluence ) );
-                if ( onlyAO ) {
-                    final = onlyAOColor * vec3( mix( vec3( ao ), vec3( 1.0 ), luminance * lumInfluence ) );
+                if ( writeAO ) {
+                    gl_FragColor = vec4( vec3( ao ), 1.0 );
+                } else {
+                    gl_FragColor = vec4( composite( texture2D( tDiffuse, vUv ).rgb, ao ), 1.0 );
                 }
-                gl_FragColor = vec4( final, 1.0 );
             }
         );
         
@@ -220,12 +248,27 @@ namespace itg
         shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
         shader.linkProgram();
         
+        string compositeShaderSrc = compositeSrc + STRINGIFY(
+            uniform sampler2D tDiffuse;
+            uniform sampler2D tAO;
+            
+            void main() {
+                vec2 vUv = gl_TexCoord[0].st;
+                gl_FragColor = vec4( composite( texture2D( tDiffuse, vUv ).rgb, texture2D( tAO, vUv ).r ), 1.0 );
+            }
+        );
+        
+        compositeShader.setupShaderFromSource(GL_FRAGMENT_SHADER, compositeShaderSrc);
+        compositeShader.linkProgram();
+        
     }
     
 
     void SSAOPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex)
     {
-        writeFbo.begin();
+        const Parameters& p = parameters.getReadRef();
+        if (accumulate) accumulator.getFrameFbo(writeFbo).begin();
+        else beginTarget(writeFbo);
         
         
         shader.begin();
@@ -233,18 +276,48 @@ namespace itg
         shader.setUniformTexture("tDiffuse", readFbo.getTexture(), 0);
         shader.setUniformTexture("tDepth", depthTex, 1);
         shader.setUniform2f("size", writeFbo.getWidth(), writeFbo.getHeight());
-        shader.setUniform1f("cameraNear", cameraNear);
-        shader.setUniform1f("cameraFar", cameraFar);
-        shader.setUniform1f("fogNear", fogNear);
-        shader.setUniform1f("fogFar", fogFar);
-        shader.setUniform1i("fogEnabled", fogEnabled ? 1 : 0 );
-        shader.setUniform1i("onlyAO", onlyAO ? 1 : 0);
-        shader.setUniform1f("aoClamp", aoClamp);
-        shader.setUniform1f("lumInfluence", lumInfluence);
+        if (depthPyramid)
+        {
+            shader.setUniform1i("useLinearDepth", 1);
+            shader.setUniformTexture("tLinearDepth", depthPyramid->getTexture(), 2);
+            shader.setUniform1f("cameraNear", depthPyramid->getCameraNear());
+            shader.setUniform1f("cameraFar", depthPyramid->getCameraFar());
+        }
+        else
+        {
+            shader.setUniform1i("useLinearDepth", 0);
+            shader.setUniform1f("cameraNear", p.cameraNear);
+            shader.setUniform1f("cameraFar", p.cameraFar);
+        }
+        shader.setUniform1f("fogNear", p.fogNear);
+        shader.setUniform1f("fogFar", p.fogFar);
+        shader.setUniform1i("fogEnabled", p.fogEnabled ? 1 : 0 );
+        shader.setUniform1i("onlyAO", p.onlyAO ? 1 : 0);
+        shader.setUniform1f("aoClamp", p.aoClamp);
+        shader.setUniform1f("lumInfluence", p.lumInfluence);
+        shader.setUniform1f("patternRotation", accumulate ? accumulator.getPatternRotation() : 0.f);
+        shader.setUniform1i("writeAO", accumulate ? 1 : 0);
         
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        if (accumulate) accumulator.getFrameFbo(writeFbo).end();
+        else endTarget(writeFbo);
+        
+        if (accumulate)
+        {
+            // only the occlusion is averaged, the colour is always this frame's
+            ofTexture& ao = accumulator.resolve(depthTex, frameInfo);
+            
+            beginTarget(writeFbo);
+            compositeShader.begin();
+            compositeShader.setUniformTexture("tDiffuse", readFbo.getTexture(), 0);
+            compositeShader.setUniformTexture("tAO", ao, 1);
+            compositeShader.setUniform1i("onlyAO", p.onlyAO ? 1 : 0);
+            compositeShader.setUniform1f("lumInfluence", p.lumInfluence);
+            texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+            compositeShader.end();
+            endTarget(writeFbo);
+        }
     }
 }
\ No newline at end of file
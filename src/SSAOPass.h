@@ -33,6 +33,8 @@
 
 #include "RenderPass.h"
 #include "ofShader.h"
+#include "TemporalAccumulator.h"
+#include "TripleBuffer.h"
 
 namespace itg
 {
@@ -45,30 +47,50 @@ namespace itg
         
         typedef shared_ptr<SSAOPass> Ptr;
         
+        struct Parameters
+        {
+            float cameraNear;
+            float cameraFar;
+            float fogNear;
+            float fogFar;
+            bool fogEnabled;
+            bool onlyAO;
+            float aoClamp;
+            float lumInfluence;
+        };
+        
         SSAOPass(const ofVec2f& aspect, bool arb, float cameraNear = 1, float cameraFar = 1000, float fogNear = 1, float fogFar = 1000, bool fogEnabled = false, bool onlyAO = false, float aoClamp = 0.5, float lumInfluence = 0.9);
         
         void render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth);
         
-        void setCameraNear(float v){ cameraNear = v; }
-        void setCameraFar(float v){ cameraFar = v; }
-        void setFogNear(float v){ fogNear = v; }
-        void setFogFar(float v){ fogFar = v; }
-        void setFogEnabled(bool v){ fogEnabled = v; }
-        void setOnlyAO(bool v){ onlyAO = v; }
-        void setAoClamp(float v){ aoClamp = v; }
-        void setLumInfluence(float v){ lumInfluence = v; }
+        // the camera given to PostProcessing::begin(cam) overrides near and far
+        bool usesDepthPyramid() const { return true; }
+        
+        // setters can be called from any thread, the values are used from the next PostProcessing::begin()
+        void setCameraNear(float v){ parameters.modify([v](Parameters& p) { p.cameraNear = v; }); }
+        void setCameraFar(float v){ parameters.modify([v](Parameters& p) { p.cameraFar = v; }); }
+        void setFogNear(float v){ parameters.modify([v](Parameters& p) { p.fogNear = v; }); }
+        void setFogFar(float v){ parameters.modify([v](Parameters& p) { p.fogFar = v; }); }
+        void setFogEnabled(bool v){ parameters.modify([v](Parameters& p) { p.fogEnabled = v; }); }
+        void setOnlyAO(bool v){ parameters.modify([v](Parameters& p) { p.onlyAO = v; }); }
+        void setAoClamp(float v){ parameters.modify([v](Parameters& p) { p.aoClamp = v; }); }
+        void setLumInfluence(float v){ parameters.modify([v](Parameters& p) { p.lumInfluence = v; }); }
+        
+        void setParameters(const Parameters& parameters) { this->parameters.write(parameters); }
+        Parameters getLatestParameters() const { return parameters.getLatest(); }
+        void latchParameters() { parameters.latch(); }
+        
+        // rotate the samples each frame and average them over time
+        void setAccumulate(bool v){ accumulate = v; }
+        bool getAccumulate() const { return accumulate; }
+        TemporalAccumulator& getAccumulator() { return accumulator; }
     private:
         
         ofShader shader;
+        ofShader compositeShader;
+        TemporalAccumulator accumulator;
+        bool accumulate;
         
-        float cameraNear;
-        float cameraFar;
-        float fogNear;
-        float fogFar;
-        bool fogEnabled;
-        bool onlyAO;
-        float aoClamp;
-        float lumInfluence;
-        
+        TripleBuffer<Parameters> parameters;
     };
 }
\ No newline at end of file
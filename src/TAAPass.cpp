@@ -0,0 +1,164 @@
+/*
+ *  TAAPass.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "TAAPass.h"
+
+namespace itg
+{
+    TAAPass::TAAPass(const ofVec2f& aspect, bool arb, float feedback) :
+        currentHistory(0), historyValid(false), RenderPass(aspect, arb, "taa")
+    {
+        Parameters p = { feedback };
+        parameters.write(p);
+        parameters.latch();
+        guiParameters = latchedGuiParameters = p;
+        
+        string fragShaderSrc = STRINGIFY(
+            uniform sampler2D tex;
+            uniform sampler2D historyTex;
+            uniform sampler2D depthTex;
+            uniform mat4 reprojection;
+            uniform vec2 texel;
+            uniform float feedback;
+            uniform bool historyValid;
+            
+            void main()
+            {
+                vec2 uv = gl_TexCoord[0].st;
+                vec4 current = texture2D(tex, uv);
+                
+                // the same colour goes to the history and, when it's attached, the output
+                if (!historyValid)
+                {
+                    gl_FragData[0] = current;
+                    gl_FragData[1] = current;
+                    return;
+                }
+                
+                // 3x3 neighbourhood bounds
+                vec4 minColor = current;
+                vec4 maxColor = current;
+                for (int y = -1; y <= 1; ++y)
+                {
+                    for (int x = -1; x <= 1; ++x)
+                    {
+                        vec4 c = texture2D(tex, uv + texel * vec2(float(x), float(y)));
+                        minColor = min(minColor, c);
+                        maxColor = max(maxColor, c);
+                    }
+                }
+                
+                // where this pixel was last frame
+                float depth = texture2D(depthTex, uv).r;
+                vec4 previous = reprojection * vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+                vec2 previousUv = previous.xy / previous.w * 0.5 + 0.5;
+                
+                vec4 history = clamp(texture2D(historyTex, previousUv), minColor, maxColor);
+                
+                float amount = feedback;
+                if (any(lessThan(previousUv, vec2(0.0))) || any(greaterThan(previousUv, vec2(1.0)))) amount = 0.0;
+                
+                vec4 result = mix(current, history, amount);
+                gl_FragData[0] = result;
+                gl_FragData[1] = result;
+            }
+        );
+        
+        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
+        shader.linkProgram();
+    }
+    
+    void TAAPass::latchParameters()
+    {
+        // only publish a gui edit so sets from other threads aren't undone
+        if (guiParameters.feedback != latchedGuiParameters.feedback) setFeedback(guiParameters.feedback);
+        
+        parameters.latch();
+        guiParameters = latchedGuiParameters = parameters.getReadRef();
+    }
+    
+    void TAAPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth)
+    {
+        if (!frameInfo || !frameInfo->hasCamera)
+        {
+            historyValid = false;
+            beginTarget(writeFbo);
+            readFbo.getTexture().draw(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+            endTarget(writeFbo);
+            return;
+        }
+        
+        if (!history[0].isAllocated() || history[0].getWidth() != writeFbo.getWidth() || history[0].getHeight() != writeFbo.getHeight())
+        {
+            ofFbo::Settings s;
+            s.width = writeFbo.getWidth();
+            s.height = writeFbo.getHeight();
+            s.internalformat = GL_RGBA16F;
+            // there's no arb shader so this is never a rectangle texture
+            s.textureTarget = GL_TEXTURE_2D;
+            for (unsigned i = 0; i < 2; ++i) history[i].allocate(s);
+            historyValid = false;
+        }
+        
+        // clip space of this frame to clip space of the last
+        ofMatrix4x4 reprojection = frameInfo->viewProjection.getInverse() * frameInfo->previousViewProjection;
+        
+        // write the history and writeFbo in one go, when drawing to the
+        // output the history is resolved first and then drawn to it
+        unsigned target = 1 - currentHistory;
+        const bool outputToWriteFbo = !hasOutputTarget();
+        if (outputToWriteFbo) history[target].attachTexture(writeFbo.getTexture(), writeFbo.getTexture().getTextureData().glInternalFormat, 1);
+        history[target].begin();
+        if (outputToWriteFbo) history[target].activateAllDrawBuffers();
+        else history[target].setActiveDrawBuffer(0);
+        shader.begin();
+        shader.setUniformTexture("tex", readFbo.getTexture(), 0);
+        shader.setUniformTexture("historyTex", history[currentHistory].getTexture(), 1);
+        shader.setUniformTexture("depthTex", depth, 2);
+        shader.setUniformMatrix4f("reprojection", reprojection);
+        shader.setUniform2f("texel", 1.f / writeFbo.getWidth(), 1.f / writeFbo.getHeight());
+        shader.setUniform1f("feedback", parameters.getReadRef().feedback);
+        shader.setUniform1i("historyValid", historyValid && frameInfo->hasPreviousCamera ? 1 : 0);
+        texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+        shader.end();
+        history[target].end();
+        
+        if (!outputToWriteFbo)
+        {
+            beginTarget(writeFbo);
+            history[target].getTexture().draw(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
+            endTarget(writeFbo);
+        }
+        
+        currentHistory = target;
+        historyValid = true;
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ *  TAAPass.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "RenderPass.h"
+#include "ofShader.h"
+#include "TripleBuffer.h"
+
+namespace itg
+{
+    /*
+     * Temporal anti-aliasing, PostProcessing jitters the camera while this
+     * is enabled and the pass blends each frame with the reprojected history
+     * clamped to the current pixel's neighbourhood. Needs the scene to be
+     * drawn with PostProcessing::begin(cam), otherwise it passes through.
+     */
+    class TAAPass : public RenderPass
+    {
+    public:
+        typedef shared_ptr<TAAPass> Ptr;
+        
+        struct Parameters
+        {
+            float feedback;
+        };
+        
+        TAAPass(const ofVec2f& aspect, bool arb, float feedback = 0.9f);
+        
+        void render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depth);
+        
+        bool usesJitter() const { return true; }
+        bool usesDepth() const { return true; }
+        
+        // how much of the history is kept each frame, can be set from any thread and is used from
+        // the next PostProcessing::begin(). The Ref getter edits a render thread copy, see DofAltPass.
+        float getFeedback() const { return parameters.getLatest().feedback; }
+        void setFeedback(float feedback) { parameters.modify([feedback](Parameters& p) { p.feedback = feedback; }); }
+        float& getFeedbackRef() { return guiParameters.feedback; }
+        
+        void setParameters(const Parameters& parameters) { this->parameters.write(parameters); }
+        Parameters getLatestParameters() const { return parameters.getLatest(); }
+        void latchParameters();
+        
+        // drop the history, e.g. on a cut
+        void reset() { historyValid = false; }
+        
+    private:
+        ofShader shader;
+        ofFbo history[2];
+        unsigned currentHistory;
+        bool historyValid;
+        
+        TripleBuffer<Parameters> parameters;
+        // render thread only, what the Ref getter edits and what it held after the last latch
+        Parameters guiParameters;
+        Parameters latchedGuiParameters;
+    };
+}
@@ -0,0 +1,166 @@
+/*
+ *  TemporalAccumulator.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "TemporalAccumulator.h"
+
+namespace itg
+{
+    TemporalAccumulator::TemporalAccumulator() :
+        currentHistory(0), numFrames(0), maxFrames(32), sampleIndex(0), depthRejection(0.05f), neighbourhoodClamp(true)
+    {
+        string fragShaderSrc = STRINGIFY(
+            uniform sampler2D frameTex;
+            uniform sampler2D historyTex;
+            uniform sampler2D depthTex;
+            uniform mat4 reprojection;
+            uniform vec2 texel;
+            uniform float blend;
+            uniform float cameraNear;
+            uniform float cameraFar;
+            uniform float depthRejection;
+            uniform bool neighbourhoodClamp;
+            
+            float eyeDepth(float depth)
+            {
+                float z = depth * 2.0 - 1.0;
+                return 2.0 * cameraNear * cameraFar / (cameraFar + cameraNear - z * (cameraFar - cameraNear));
+            }
+            
+            void main()
+            {
+                vec2 uv = gl_TexCoord[0].st;
+                vec4 current = texture2D(frameTex, uv);
+                float depth = texture2D(depthTex, uv).r;
+                
+                vec4 previous = reprojection * vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+                previous /= previous.w;
+                vec2 previousUv = previous.xy * 0.5 + 0.5;
+                
+                vec3 result = current.rgb;
+                if (all(greaterThanEqual(previousUv, vec2(0.0))) && all(lessThanEqual(previousUv, vec2(1.0))))
+                {
+                    vec4 history = texture2D(historyTex, previousUv);
+                    float expected = eyeDepth(previous.z * 0.5 + 0.5);
+                    // something else was at this point last frame
+                    if (abs(history.a - expected) <= depthRejection * expected)
+                    {
+                        if (neighbourhoodClamp)
+                        {
+                            vec3 low = current.rgb;
+                            vec3 high = current.rgb;
+                            for (int y = -1; y <= 1; ++y)
+                            {
+                                for (int x = -1; x <= 1; ++x)
+                                {
+                                    vec3 neighbour = texture2D(frameTex, uv + vec2(float(x), float(y)) * texel).rgb;
+                                    low = min(low, neighbour);
+                                    high = max(high, neighbour);
+                                }
+                            }
+                            history.rgb = clamp(history.rgb, low, high);
+                        }
+                        result = mix(history.rgb, current.rgb, mix(1.0, blend, current.a));
+                    }
+                }
+                gl_FragColor = vec4(result, eyeDepth(depth));
+            }
+        );
+        
+        shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
+        shader.linkProgram();
+    }
+    
+    ofFbo& TemporalAccumulator::getFrameFbo(ofFbo& writeFbo)
+    {
+        if (!frame.isAllocated() || frame.getWidth() != writeFbo.getWidth() || frame.getHeight() != writeFbo.getHeight())
+        {
+            // sampled with normalised coordinates whatever the arb default is
+            ofFbo::Settings s;
+            s.width = writeFbo.getWidth();
+            s.height = writeFbo.getHeight();
+            s.internalformat = GL_RGBA;
+            s.textureTarget = GL_TEXTURE_2D;
+            frame.allocate(s);
+            s.internalformat = GL_RGBA16F;
+            for (unsigned i = 0; i < 2; ++i) history[i].allocate(s);
+            numFrames = 0;
+        }
+        return frame;
+    }
+    
+    float TemporalAccumulator::getPatternRotation() const
+    {
+        // golden ratio sequence so consecutive frames are far apart
+        float rotation = sampleIndex * 0.6180339887f;
+        return rotation - floorf(rotation);
+    }
+    
+    ofTexture& TemporalAccumulator::resolve(ofTexture& depth, const FrameInfo* frameInfo)
+    {
+        FrameInfo defaults;
+        const FrameInfo& info = frameInfo ? *frameInfo : defaults;
+        bool reproject = info.hasCamera && info.hasPreviousCamera && info.cameraMoved;
+        if (info.hasCamera && !info.hasPreviousCamera) numFrames = 0;
+        // keep a little history while moving so it doesn't flicker
+        if (reproject) numFrames = min(numFrames, 3u);
+        
+        ofMatrix4x4 reprojection;
+        if (reproject) reprojection = info.viewProjection.getInverse() * info.previousViewProjection;
+        
+        unsigned target = 1 - currentHistory;
+        history[target].begin();
+        shader.begin();
+        shader.setUniformTexture("frameTex", frame.getTexture(), 0);
+        shader.setUniformTexture("historyTex", history[currentHistory].getTexture(), 1);
+        shader.setUniformTexture("depthTex", depth, 2);
+        shader.setUniformMatrix4f("reprojection", reprojection);
+        shader.setUniform2f("texel", 1.f / frame.getWidth(), 1.f / frame.getHeight());
+        shader.setUniform1f("blend", 1.f / (numFrames + 1));
+        shader.setUniform1f("cameraNear", info.cameraNear);
+        shader.setUniform1f("cameraFar", info.cameraFar);
+        shader.setUniform1f("depthRejection", depthRejection);
+        shader.setUniform1i("neighbourhoodClamp", neighbourhoodClamp ? 1 : 0);
+        glBegin(GL_QUADS);
+        glTexCoord2f(0, 0); glVertex2f(0, 0);
+        glTexCoord2f(1, 0); glVertex2f(frame.getWidth(), 0);
+        glTexCoord2f(1, 1); glVertex2f(frame.getWidth(), frame.getHeight());
+        glTexCoord2f(0, 1); glVertex2f(0, frame.getHeight());
+        glEnd();
+        shader.end();
+        history[target].end();
+        
+        currentHistory = target;
+        numFrames = min(numFrames + 1, maxFrames - 1);
+        ++sampleIndex;
+        
+        return history[target].getTexture();
+    }
+}
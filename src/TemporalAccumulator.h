@@ -0,0 +1,87 @@
+/*
+ *  TemporalAccumulator.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "RenderPass.h"
+
+namespace itg
+{
+    /*
+     * Progressive refinement for noisy passes. The pass renders only its noisy
+     * term (the occlusion, the blur) with its sample pattern rotated by
+     * getPatternRotation() into getFrameFbo(), resolve() averages it with the
+     * history and the pass composites the returned texture. The alpha of the
+     * frame is how much of the pixel to average, 0 takes the frame as is.
+     * History is reprojected with depth when the camera moves, dropped where
+     * its depth doesn't match (disocclusion, moving objects) and clamped to
+     * the frame's 3x3 neighbourhood so animated content doesn't ghost.
+     */
+    class TemporalAccumulator
+    {
+    public:
+        TemporalAccumulator();
+        
+        ofFbo& getFrameFbo(ofFbo& writeFbo);
+        
+        // in [0, 1), multiply by the angle between samples
+        float getPatternRotation() const;
+        
+        // returns the accumulated term, valid until the next resolve()
+        ofTexture& resolve(ofTexture& depth, const FrameInfo* frameInfo);
+        
+        void reset() { numFrames = 0; }
+        
+        unsigned getNumFrames() const { return numFrames; }
+        
+        unsigned getMaxFrames() const { return maxFrames; }
+        void setMaxFrames(unsigned maxFrames) { this->maxFrames = max(maxFrames, 1u); }
+        
+        // relative difference in eye depth past which history is dropped
+        float getDepthRejection() const { return depthRejection; }
+        void setDepthRejection(float depthRejection) { this->depthRejection = depthRejection; }
+        
+        bool getNeighbourhoodClamp() const { return neighbourhoodClamp; }
+        void setNeighbourhoodClamp(bool neighbourhoodClamp) { this->neighbourhoodClamp = neighbourhoodClamp; }
+        
+    private:
+        ofShader shader;
+        ofFbo frame;
+        // rgb is the accumulated term, alpha the eye depth it was accumulated at
+        ofFbo history[2];
+        unsigned currentHistory;
+        unsigned numFrames;
+        unsigned maxFrames;
+        unsigned sampleIndex;
+        float depthRejection;
+        bool neighbourhoodClamp;
+    };
+}
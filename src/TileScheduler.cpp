@@ -0,0 +1,274 @@
+/*
+ *  TileScheduler.cpp
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#include "TileScheduler.h"
+
+namespace itg
+{
+    TileScheduler::TileScheduler(unsigned numThreads, unsigned tileSize) :
+        numRemaining(0), numSteals(0), numQueued(0), numIdle(0), generation(0), numBusy(0), stopping(false),
+        tileSize(max(tileSize, 1u)), builtWidth(0), builtHeight(0), dirty(true)
+    {
+        setNumThreads(numThreads);
+    }
+
+    TileScheduler::~TileScheduler()
+    {
+        stopThreads();
+    }
+
+    void TileScheduler::setNumThreads(unsigned numThreads)
+    {
+        if (numThreads == 0) numThreads = thread::hardware_concurrency();
+        stopThreads();
+        this->numThreads = max(numThreads, 1u);
+        workers.reset(new Worker[this->numThreads]);
+    }
+
+    void TileScheduler::setTileSize(unsigned tileSize)
+    {
+        this->tileSize = max(tileSize, 1u);
+        dirty = true;
+    }
+
+    void TileScheduler::startThreads()
+    {
+        stopping = false;
+        threads.reserve(numThreads - 1);
+        for (unsigned i = 1; i < numThreads; ++i)
+        {
+            threads.push_back(thread(&TileScheduler::workerThread, this, i, generation));
+        }
+    }
+
+    void TileScheduler::stopThreads()
+    {
+        {
+            lock_guard<mutex> guard(runLock);
+            stopping = true;
+        }
+        runStarted.notify_all();
+        for (unsigned i = 0; i < threads.size(); ++i) threads[i].join();
+        threads.clear();
+    }
+
+    void TileScheduler::workerThread(unsigned index, unsigned seen)
+    {
+        while (true)
+        {
+            {
+                unique_lock<mutex> guard(runLock);
+                runStarted.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            work(index);
+            {
+                lock_guard<mutex> guard(runLock);
+                if (--numBusy == 0) runFinished.notify_one();
+            }
+        }
+    }
+
+    int TileScheduler::addStage(const Kernel& kernel, const vector<Input>& inputs)
+    {
+        Stage stage;
+        stage.kernel = kernel;
+        stage.inputs = inputs;
+        stages.push_back(stage);
+        dirty = true;
+        return stages.size() - 1;
+    }
+
+    void TileScheduler::clear()
+    {
+        stages.clear();
+        tasks.clear();
+        dirty = true;
+    }
+
+    void TileScheduler::buildTasks(unsigned width, unsigned height)
+    {
+        const unsigned tilesX = (width + tileSize - 1) / tileSize;
+        const unsigned tilesY = (height + tileSize - 1) / tileSize;
+        const unsigned numTiles = tilesX * tilesY;
+
+        tasks.assign(stages.size() * numTiles, Task());
+        initialDependencies.assign(tasks.size(), 0);
+        for (unsigned s = 0; s < stages.size(); ++s)
+        {
+            for (unsigned ty = 0; ty < tilesY; ++ty)
+            {
+                for (unsigned tx = 0; tx < tilesX; ++tx)
+                {
+                    unsigned index = s * numTiles + ty * tilesX + tx;
+                    Task& task = tasks[index];
+                    task.stage = s;
+                    task.tile.x0 = tx * tileSize;
+                    task.tile.y0 = ty * tileSize;
+                    task.tile.x1 = min(task.tile.x0 + tileSize, width);
+                    task.tile.y1 = min(task.tile.y0 + tileSize, height);
+
+                    // depend on every tile of the input stages under the tile grown by the halo
+                    for (unsigned i = 0; i < stages[s].inputs.size(); ++i)
+                    {
+                        const Input& input = stages[s].inputs[i];
+                        if (input.stage < 0) continue;
+                        unsigned minX = task.tile.x0 > input.haloX ? (task.tile.x0 - input.haloX) / tileSize : 0;
+                        unsigned minY = task.tile.y0 > input.haloY ? (task.tile.y0 - input.haloY) / tileSize : 0;
+                        unsigned maxX = min((task.tile.x1 - 1 + input.haloX) / tileSize, tilesX - 1);
+                        unsigned maxY = min((task.tile.y1 - 1 + input.haloY) / tileSize, tilesY - 1);
+                        for (unsigned y = minY; y <= maxY; ++y)
+                        {
+                            for (unsigned x = minX; x <= maxX; ++x)
+                            {
+                                tasks[input.stage * numTiles + y * tilesX + x].dependents.push_back(index);
+                                ++initialDependencies[index];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        numDependencies.reset(new atomic<unsigned>[tasks.size()]);
+        builtWidth = width;
+        builtHeight = height;
+        dirty = false;
+    }
+
+    void TileScheduler::run(unsigned width, unsigned height)
+    {
+        if (stages.empty() || width == 0 || height == 0) return;
+        if (dirty || width != builtWidth || height != builtHeight) buildTasks(width, height);
+
+        numSteals = 0;
+        numRemaining = tasks.size();
+        unsigned next = 0;
+        int numReady = 0;
+        for (unsigned i = 0; i < tasks.size(); ++i)
+        {
+            numDependencies[i] = initialDependencies[i];
+            if (initialDependencies[i] == 0)
+            {
+                workers[next].tasks.push_back(i);
+                next = (next + 1) % numThreads;
+                ++numReady;
+            }
+        }
+        numQueued = numReady;
+
+        if (threads.size() + 1 != numThreads) startThreads();
+        {
+            lock_guard<mutex> guard(runLock);
+            ++generation;
+            numBusy = threads.size();
+        }
+        runStarted.notify_all();
+        work(0);
+
+        // the others may still be on their way out of work()
+        unique_lock<mutex> guard(runLock);
+        runFinished.wait(guard, [this] { return numBusy == 0; });
+    }
+
+    bool TileScheduler::popTask(unsigned index, unsigned& task)
+    {
+        {
+            lock_guard<mutex> guard(workers[index].lock);
+            if (!workers[index].tasks.empty())
+            {
+                task = workers[index].tasks.back();
+                workers[index].tasks.pop_back();
+                --numQueued;
+                return true;
+            }
+        }
+        for (unsigned i = 1; i < numThreads; ++i)
+        {
+            Worker& victim = workers[(index + i) % numThreads];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                --numQueued;
+                ++numSteals;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void TileScheduler::work(unsigned index)
+    {
+        unsigned task;
+        while (numRemaining > 0)
+        {
+            if (!popTask(index, task))
+            {
+                // park until another worker queues a task or the run is over
+                unique_lock<mutex> guard(idleLock);
+                ++numIdle;
+                taskQueued.wait(guard, [this] { return numQueued > 0 || numRemaining == 0; });
+                --numIdle;
+                continue;
+            }
+            stages[tasks[task].stage].kernel(tasks[task].tile);
+
+            // ready dependents go on this worker's deque so the tile stays in this core's cache
+            const vector<unsigned>& dependents = tasks[task].dependents;
+            for (unsigned i = 0; i < dependents.size(); ++i)
+            {
+                if (--numDependencies[dependents[i]] == 0) pushTask(index, dependents[i]);
+            }
+            if (--numRemaining == 0)
+            {
+                lock_guard<mutex> guard(idleLock);
+                taskQueued.notify_all();
+            }
+        }
+    }
+
+    void TileScheduler::pushTask(unsigned index, unsigned task)
+    {
+        {
+            lock_guard<mutex> guard(workers[index].lock);
+            workers[index].tasks.push_back(task);
+        }
+        ++numQueued;
+        // taking the lock means a worker that just found nothing is either waiting or will see the count
+        if (numIdle > 0)
+        {
+            lock_guard<mutex> guard(idleLock);
+            taskQueued.notify_one();
+        }
+    }
+}
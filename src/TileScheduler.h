@@ -0,0 +1,155 @@
+/*
+ *  TileScheduler.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+
+namespace itg
+{
+    /*
+     * Runs a chain of image stages as a graph of (stage, tile) tasks. A task
+     * waits only on the tiles of earlier stages it reads, given by the halo
+     * of each input, so later stages start on a tile as soon as its
+     * neighbourhood is ready instead of waiting for the whole image. Each
+     * worker keeps its own deque: it pushes and pops at the back so a tile
+     * tends to stay on the same core, and idle workers steal from the front
+     * of the others. The workers are started on the first run and wait on
+     * a condition variable between runs and while there's nothing to steal.
+     */
+    class TileScheduler
+    {
+    public:
+        struct Tile
+        {
+            unsigned x0, y0, x1, y1;
+        };
+
+        typedef function<void(const Tile&)> Kernel;
+
+        // the image the chain starts from, it's already complete so reading it has no dependencies
+        static const int SOURCE = -1;
+
+        struct Input
+        {
+            Input(int stage, unsigned haloX = 0, unsigned haloY = 0) : stage(stage), haloX(haloX), haloY(haloY) {}
+
+            int stage;
+            // how many pixels outside the tile are read
+            unsigned haloX, haloY;
+        };
+
+        // 0 threads uses a thread for each core, 64x64 RGBA float tiles are 64kb
+        // so a tile of each image in a stage fits in L2
+        TileScheduler(unsigned numThreads = 0, unsigned tileSize = 64);
+        ~TileScheduler();
+
+        // returns the index of the stage, the inputs can be SOURCE or earlier stages
+        int addStage(const Kernel& kernel, const vector<Input>& inputs);
+        void clear();
+
+        // runs every stage over a width x height image and returns when they're all done
+        void run(unsigned width, unsigned height);
+
+        unsigned getNumThreads() const { return numThreads; }
+        void setNumThreads(unsigned numThreads);
+
+        unsigned getTileSize() const { return tileSize; }
+        void setTileSize(unsigned tileSize);
+
+        unsigned getNumStages() const { return stages.size(); }
+
+        // stats for the last run
+        unsigned getNumTasks() const { return tasks.size(); }
+        unsigned getNumSteals() const { return numSteals; }
+
+    private:
+        struct Stage
+        {
+            Kernel kernel;
+            vector<Input> inputs;
+        };
+
+        struct Task
+        {
+            unsigned stage;
+            Tile tile;
+            vector<unsigned> dependents;
+        };
+
+        struct Worker
+        {
+            mutex lock;
+            deque<unsigned> tasks;
+        };
+
+        void buildTasks(unsigned width, unsigned height);
+        void startThreads();
+        void stopThreads();
+        // the loop of every worker but the first, which is the thread calling run()
+        void workerThread(unsigned index, unsigned seen);
+        void work(unsigned index);
+        bool popTask(unsigned index, unsigned& task);
+        void pushTask(unsigned index, unsigned task);
+
+        vector<Stage> stages;
+        vector<Task> tasks;
+        unique_ptr<atomic<unsigned>[]> numDependencies;
+        vector<unsigned> initialDependencies;
+        unique_ptr<Worker[]> workers;
+        atomic<unsigned> numRemaining;
+        atomic<unsigned> numSteals;
+
+        // tasks in the deques, can go briefly negative as a pop overtakes its push's count
+        atomic<int> numQueued;
+        atomic<unsigned> numIdle;
+        mutex idleLock;
+        condition_variable taskQueued;
+
+        vector<thread> threads;
+        mutex runLock;
+        condition_variable runStarted;
+        condition_variable runFinished;
+        unsigned generation;
+        unsigned numBusy;
+        bool stopping;
+
+        unsigned numThreads;
+        unsigned tileSize;
+        unsigned builtWidth, builtHeight;
+        bool dirty;
+    };
+}
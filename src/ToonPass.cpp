@@ -147,7 +147,7 @@ namespace itg
     void ToonPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex)
     {
         
-        writeFbo.begin();
+        beginTarget(writeFbo);
         
         shader.begin();
         
@@ -165,6 +165,6 @@ namespace itg
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
     }
 }
\ No newline at end of file
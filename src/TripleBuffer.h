@@ -0,0 +1,104 @@
+/*
+ *  TripleBuffer.h
+ *
+ *  Copyright (c) 2013, Neil Mendoza, http://www.neilmendoza.com
+ *  All rights reserved. 
+ *  
+ *  Redistribution and use in source and binary forms, with or without 
+ *  modification, are permitted provided that the following conditions are met: 
+ *  
+ *  * Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer. 
+ *  * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution. 
+ *  * Neither the name of Neil Mendoza nor the names of its contributors may be used 
+ *    to endorse or promote products derived from this software without 
+ *    specific prior written permission. 
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ *  POSSIBILITY OF SUCH DAMAGE. 
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+namespace itg
+{
+    using namespace std;
+    
+    /*
+     * Hands a block of values from control threads (gui, osc, midi) to the
+     * render thread. Writers fill a spare copy and swap it in with one
+     * atomic exchange, and latch() swaps the newest one out for reading.
+     * Writers are serialised with each other by a mutex but the reader
+     * never takes it and never waits. T is copied whole so keep it small
+     * and POD.
+     */
+    template<class T>
+    class TripleBuffer
+    {
+    public:
+        TripleBuffer(const T& value = T()) : latest(value), writeIndex(0), readIndex(1), middle(2)
+        {
+            for (unsigned i = 0; i < 3; ++i) buffers[i] = value;
+        }
+        
+        // any thread, f is called with the newest values to change them
+        template<class F>
+        void modify(F f)
+        {
+            lock_guard<mutex> guard(writeLock);
+            f(latest);
+            buffers[writeIndex] = latest;
+            writeIndex = middle.exchange(writeIndex | FRESH, memory_order_acq_rel) & INDEX;
+        }
+        
+        void write(const T& value)
+        {
+            modify([&value](T& t) { t = value; });
+        }
+        
+        // any thread, the newest values written which may not be latched yet
+        T getLatest() const
+        {
+            lock_guard<mutex> guard(writeLock);
+            return latest;
+        }
+        
+        // render thread, returns true if newer values were picked up
+        bool latch()
+        {
+            if (!(middle.load(memory_order_relaxed) & FRESH)) return false;
+            readIndex = middle.exchange(readIndex, memory_order_acq_rel) & INDEX;
+            return true;
+        }
+        
+        // render thread, the values as of the last latch()
+        const T& getReadRef() const { return buffers[readIndex]; }
+        T& getReadRef() { return buffers[readIndex]; }
+        
+    private:
+        static const unsigned INDEX = 3;
+        static const unsigned FRESH = 4;
+        
+        T buffers[3];
+        T latest;
+        mutable mutex writeLock;
+        unsigned writeIndex;
+        unsigned readIndex;
+        // index of the spare buffer, FRESH when it holds values the reader hasn't seen
+        atomic<unsigned> middle;
+    };
+}
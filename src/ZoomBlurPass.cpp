@@ -37,7 +37,7 @@ namespace itg
     ZoomBlurPass::ZoomBlurPass(const ofVec2f& aspect, bool arb, float centerX, float centerY,
                                    float exposure, float decay, float density,
                                    float weight, float clamp) :
-        centerX(centerX), centerY(centerY), exposure(exposure), decay(decay), density(density), weight(weight), clamp(clamp), RenderPass(aspect, arb, "zoomblur")
+        centerX(centerX), centerY(centerY), exposure(exposure), decay(decay), density(density), weight(weight), clamp(clamp), mode(MODE_SINGLE_PASS), numPasses(2), RenderPass(aspect, arb, "zoomblur")
     {
         
         string fragShaderSrc = STRINGIFY(
@@ -81,11 +81,58 @@ namespace itg
         shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShaderSrc);
         shader.linkProgram();
         
+        // intermediate passes leave the sum unscaled in a float target
+        string iterativeShaderSrc = STRINGIFY(
+            uniform sampler2D tDiffuse;
+            
+            uniform float fX;
+            uniform float fY;
+            uniform float fStep;
+            uniform float fStart;
+            uniform float fDecay;
+            uniform float fScale;
+            uniform float fClamp;
+            uniform bool bFinal;
+            
+            void main()
+            {
+                vec2 vUv = gl_TexCoord[0].st;
+                vec2 deltaTextCoord = vec2(vUv - vec2(fX,fY)) * fStep;
+                float illuminationDecay = 1.0;
+                vec4 FragColor = vec4(0.0);
+                
+                for(int i=0; i < 8 ; i++)
+                {
+                    FragColor += texture2D(tDiffuse, vUv - deltaTextCoord * (fStart + float(i))) * illuminationDecay;
+                    illuminationDecay *= fDecay;
+                }
+                FragColor *= fScale;
+                if (bFinal) FragColor = clamp(FragColor, 0.0, fClamp);
+                gl_FragColor = FragColor;
+            }
+        );
+        
+        iterativeShader.setupShaderFromSource(GL_FRAGMENT_SHADER, iterativeShaderSrc);
+        iterativeShader.linkProgram();
+    }
+    
+    unsigned ZoomBlurPass::getNumEffectiveSamples() const
+    {
+        if (mode == MODE_SINGLE_PASS) return 20;
+        unsigned numSamples = 8;
+        for (unsigned i = 1; i < numPasses; ++i) numSamples *= 8;
+        return numSamples;
     }
     
     void ZoomBlurPass::render(ofFbo& readFbo, ofFbo& writeFbo, ofTexture& depthTex)
     {
-        writeFbo.begin();
+        if (mode == MODE_ITERATIVE)
+        {
+            renderIterative(readFbo, writeFbo);
+            return;
+        }
+        
+        beginTarget(writeFbo);
         
         
         shader.begin();
@@ -102,6 +149,53 @@ namespace itg
         texturedQuad(0, 0, writeFbo.getWidth(), writeFbo.getHeight());
         
         shader.end();
-        writeFbo.end();
+        endTarget(writeFbo);
+    }
+    
+    void ZoomBlurPass::renderIterative(ofFbo& readFbo, ofFbo& writeFbo)
+    {
+        if (numPasses > 1 && (!scratch[0].isAllocated() || scratch[0].getWidth() != readFbo.getWidth() || scratch[0].getHeight() != readFbo.getHeight()))
+        {
+            // same target as the ping pongs, not openFrameworks' arb default
+            ofFbo::Settings s;
+            s.width = readFbo.getWidth();
+            s.height = readFbo.getHeight();
+            s.internalformat = GL_RGBA16F;
+            s.textureTarget = arb ? GL_TEXTURE_RECTANGLE_ARB : GL_TEXTURE_2D;
+            for (unsigned i = 0; i < 2; ++i) scratch[i].allocate(s);
+        }
+        
+        // spread the same streak length and total weight as the single pass over more samples
+        const float numSamples = getNumEffectiveSamples();
+        const float sampleDecay = powf(decay, 20.f / numSamples);
+        float step = density / numSamples;
+        float tapDecay = sampleDecay;
+        
+        ofFbo* source = &readFbo;
+        for (unsigned i = 0; i < numPasses; ++i)
+        {
+            bool last = i == numPasses - 1;
+            ofFbo& target = last ? writeFbo : scratch[i % 2];
+            
+            target.begin();
+            iterativeShader.begin();
+            iterativeShader.setUniformTexture("tDiffuse", source->getTexture(), 0);
+            iterativeShader.setUniform1f("fX", centerX);
+            iterativeShader.setUniform1f("fY", centerY);
+            iterativeShader.setUniform1f("fStep", step);
+            // the single pass doesn't sample the pixel itself
+            iterativeShader.setUniform1f("fStart", i == 0 ? 1.f : 0.f);
+            iterativeShader.setUniform1f("fDecay", tapDecay);
+            iterativeShader.setUniform1f("fScale", last ? weight * exposure * 20.f / numSamples : 1.f);
+            iterativeShader.setUniform1f("fClamp", clamp);
+            iterativeShader.setUniform1i("bFinal", last ? 1 : 0);
+            texturedQuad(0, 0, target.getWidth(), target.getHeight());
+            iterativeShader.end();
+            target.end();
+            
+            source = &target;
+            step *= 8.f;
+            tapDecay = powf(tapDecay, 8.f);
+        }
     }
-}
\ No newline at end of file
+}
@@ -42,6 +42,15 @@ namespace itg
         
         typedef shared_ptr<ZoomBlurPass> Ptr;
         
+        enum Mode
+        {
+            // 20 samples in one pass
+            MODE_SINGLE_PASS,
+            // 8 samples per pass at 8 times the stride of the pass before so
+            // 1, 2 or 3 passes give 8, 64 or 512 samples along the streak
+            MODE_ITERATIVE
+        };
+        
         ZoomBlurPass(const ofVec2f& aspect, bool arb, float centerX = 0.5, float centerY = 0.5,
                        float exposure = 0.48, float decay = 0.9, float density = 0.25,
                        float weight = 0.25, float clamp = 1);
@@ -68,9 +77,24 @@ namespace itg
         
         void setClamp(float v){ clamp = v; }
         float getClamp() { return clamp; }
+        
+        void setMode(Mode mode) { this->mode = mode; }
+        Mode getMode() const { return mode; }
+        
+        // passes used by MODE_ITERATIVE, 1 to 3
+        void setNumPasses(unsigned numPasses) { this->numPasses = max(1u, min(numPasses, 3u)); }
+        unsigned getNumPasses() const { return numPasses; }
+        
+        unsigned getNumEffectiveSamples() const;
+        
     private:
+        void renderIterative(ofFbo& readFbo, ofFbo& writeFbo);
         
         ofShader shader;
+        ofShader iterativeShader;
+        ofFbo scratch[2];
+        Mode mode;
+        unsigned numPasses;
         
         float centerX;
         float centerY;
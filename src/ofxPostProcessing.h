@@ -43,6 +43,7 @@
 #include "PostProcessing.h"
 #include "RenderPass.h"
 #include "LUTPass.h"
+#include "LUTBankPass.h"
 #include "ContrastPass.h"
 #include "SSAOPass.h"
 #include "HorizontalTiltShifPass.h"
@@ -55,6 +56,8 @@
 #include "GodRaysPass.h"
 #include "RimHighlightingPass.h"
 #include "LimbDarkeningPass.h"
+#include "TAAPass.h"
+#include "CpuBackend.h"
 
 typedef itg::PostProcessing ofxPostProcessing;
 